@@ -0,0 +1,364 @@
+// Неинтерактивный замер путей просмотра CarProcessor.
+// Перебирает размер набора, селективность и число потоков, для каждой точки делает прогревочные
+// и измеряемые прогоны и печатает медиану, 95-й процентиль, ускорение и эффективность.
+//
+// Сборка (из каталога task2):
+//   g++ -std=c++20 -O2 -Wall -pthread -I. benchmark/benchmark.cpp $(ls *.cpp | grep -v main.cpp) -o car_benchmark
+//
+// Примеры:
+//   ./car_benchmark
+//   ./car_benchmark --sizes 1000000,100000000 --threads 1,8,16 --csv bench.csv --json bench.json
+//   ./car_benchmark --paths select_columnar,aggregate --selectivity 0.01 --repeat 20
+//   ./car_benchmark --schedules static,morsel,affinity --threads 1,16,32
+//
+// Набор на 100 млн строк занимает около 5 ГБ (массив структур, колонки и индексы),
+// поэтому по умолчанию размеры ограничены 10 млн.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include "car.h"
+#include "car_dataset.h"
+#include "car_generator.h"
+#include "car_predicate.h"
+#include "car_processor.h"
+#include "compressed_car_table.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Представления одного набора, по которым идут запросы
+struct BenchmarkTarget {
+    const CarProcessor& processor;
+    const CompressedCarTable* compressed;   // Строится, только если выбран путь packed_*
+};
+
+// Путь просмотра: как настроить процессор и как выполнить запрос.
+// run возвращает число найденных строк, чтобы результат нельзя было выбросить при оптимизации.
+struct ScanPath {
+    string name;
+    bool multiThreaded;    // Однопоточные пути замеряются только для одного потока
+    ScanMode mode;
+    bool useIndexes;
+    function<size_t(const BenchmarkTarget&, const CarCriteria&, int)> run;
+    bool needsCompressed = false;
+};
+
+static vector<ScanPath> allScanPaths() {
+    return {
+        {"process_single", false, ScanMode::RowWise, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int) { return t.processor.processSingleThread(c).size(); }},
+        {"process_multi", true, ScanMode::RowWise, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.processMultiThread(c, n).size(); }},
+        {"select_single", false, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int) { return t.processor.selectSingleThread(c).size(); }},
+        {"select_rowwise", true, ScanMode::RowWise, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.selectMultiThread(c, n).size(); }},
+        {"select_columnar", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.selectMultiThread(c, n).size(); }},
+        {"select_index", true, ScanMode::Columnar, true,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.selectMultiThread(c, n).size(); }},
+        {"select_where", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.selectWhere(criteriaPredicate(c), n).size(); }},
+        {"select_bitmap", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.selectBitmap(c, n).count(); }},
+        {"aggregate", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.processor.aggregate(c, n).count; }},
+        {"top_k", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) {
+             return t.processor.selectTopK(c, {SortField::Price, false}, 100, n).size();
+         }},
+        {"packed_select", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.compressed->select(c, n).size(); }, true},
+        {"packed_agg", true, ScanMode::Columnar, false,
+         [](const BenchmarkTarget& t, const CarCriteria& c, int n) { return t.compressed->aggregate(c, n).count; }, true},
+    };
+}
+
+struct BenchmarkOptions {
+    vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    vector<double> selectivities = {0.001, 0.01, 0.1, 0.5, 1.0};
+    vector<int> threads;                 // Пусто - 1, 2, 4, ... до числа ядер
+    vector<string> paths;                // Пусто - все пути
+    vector<ScanScheduling> schedules = {ScanScheduling::Morsel};
+    int warmup = 1;
+    int repeat = 5;
+    uint64_t seed = 42;
+    string csvPath;
+    string jsonPath;
+};
+
+// Одна точка замера
+struct BenchmarkResult {
+    string path;
+    string schedule;
+    size_t rows = 0;
+    double selectivity = 0;              // Заданная
+    size_t matched = 0;                  // Фактически найдено строк
+    int threads = 1;
+    int repeat = 0;
+    double medianSeconds = 0;
+    double p95Seconds = 0;
+    double minSeconds = 0;
+    double speedup = 1;                  // Относительно первой точки того же пути
+    double efficiency = 1;               // Ускорение на поток относительно первой точки
+
+    double rowsPerSecond() const { return medianSeconds > 0 ? rows / medianSeconds : 0.0; }
+};
+
+static string schedulingName(ScanScheduling scheduling) {
+    switch (scheduling) {
+        case ScanScheduling::Static: return "static";
+        case ScanScheduling::Affinity: return "affinity";
+        default: return "morsel";
+    }
+}
+
+static ScanScheduling parseScheduling(const string& name) {
+    for (auto scheduling : {ScanScheduling::Static, ScanScheduling::Morsel, ScanScheduling::Affinity}) {
+        if (schedulingName(scheduling) == name) return scheduling;
+    }
+    throw invalid_argument("Неизвестное распределение: " + name);
+}
+
+template <typename T, typename Parse>
+static vector<T> parseList(const string& text, Parse parse) {
+    vector<T> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        if (!item.empty()) values.push_back(parse(item));
+    }
+    if (values.empty()) {
+        throw invalid_argument("Пустой список: " + text);
+    }
+    return values;
+}
+
+static BenchmarkOptions parseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("Не указано значение для " + arg);
+        }
+        string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes = parseList<size_t>(value, [](const string& s) { return static_cast<size_t>(stoull(s)); });
+        } else if (arg == "--selectivity") {
+            options.selectivities = parseList<double>(value, [](const string& s) { return stod(s); });
+        } else if (arg == "--threads") {
+            options.threads = parseList<int>(value, [](const string& s) { return stoi(s); });
+        } else if (arg == "--paths") {
+            options.paths = parseList<string>(value, [](const string& s) { return s; });
+        } else if (arg == "--schedules") {
+            options.schedules = parseList<ScanScheduling>(value, parseScheduling);
+        } else if (arg == "--warmup") {
+            options.warmup = stoi(value);
+        } else if (arg == "--repeat") {
+            options.repeat = stoi(value);
+        } else if (arg == "--seed") {
+            options.seed = stoull(value);
+        } else if (arg == "--csv") {
+            options.csvPath = value;
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else {
+            throw invalid_argument("Неизвестный параметр: " + arg);
+        }
+    }
+
+    for (size_t rows : options.sizes) {
+        if (rows > UINT32_MAX) throw invalid_argument("Размер набора превышает предел номера строки");
+    }
+    for (double s : options.selectivities) {
+        if (s <= 0 || s > 1) throw invalid_argument("Селективность должна быть в диапазоне (0, 1]");
+    }
+    for (int t : options.threads) {
+        if (t < 1) throw invalid_argument("Число потоков должно быть положительным");
+    }
+    if (options.warmup < 0 || options.repeat < 1) {
+        throw invalid_argument("Нужен хотя бы один измеряемый прогон");
+    }
+    if (options.threads.empty()) {
+        int cores = max(1, static_cast<int>(thread::hardware_concurrency()));
+        for (int t = 1; t < cores; t *= 2) options.threads.push_back(t);
+        options.threads.push_back(cores);
+    }
+    return options;
+}
+
+// Критерии с заданной долей подходящих строк: цены генератора равномерны на [5000, 100000],
+// остальные условия открыты
+static CarCriteria criteriaForSelectivity(double selectivity) {
+    const int lo = 5000, hi = 100000;
+    int maxPrice = lo + static_cast<int>(lround(selectivity * (hi - lo + 1))) - 1;
+    return {lo, min(max(maxPrice, lo), hi), INT_MAX, 0};
+}
+
+// Значение процентиля по отсортированной выборке (метод ближайшего ранга)
+static double percentile(const vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(ceil(p * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+static BenchmarkResult measure(const ScanPath& path, const BenchmarkTarget& target, const CarCriteria& criteria,
+                               int threads, const BenchmarkOptions& options) {
+    for (int i = 0; i < options.warmup; ++i) {
+        path.run(target, criteria, threads);
+    }
+
+    BenchmarkResult result;
+    vector<double> times;
+    for (int i = 0; i < options.repeat; ++i) {
+        auto start = chrono::steady_clock::now();
+        result.matched = path.run(target, criteria, threads);
+        times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+
+    result.path = path.name;
+    result.threads = threads;
+    result.repeat = options.repeat;
+    result.minSeconds = times.front();
+    result.medianSeconds = times.size() % 2 ? times[times.size() / 2]
+                                            : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+    result.p95Seconds = percentile(times, 0.95);
+    return result;
+}
+
+static void writeCsv(const string& path, const vector<BenchmarkResult>& results) {
+    ofstream out(path);
+    if (!out) throw runtime_error("Не удалось создать " + path);
+
+    out << "path,schedule,rows,selectivity,matched,threads,repeat,median_s,p95_s,min_s,rows_per_s,speedup,efficiency\n";
+    out << setprecision(9);
+    for (const auto& r : results) {
+        out << r.path << ',' << r.schedule << ',' << r.rows << ',' << r.selectivity << ',' << r.matched << ',' << r.threads << ','
+            << r.repeat << ',' << r.medianSeconds << ',' << r.p95Seconds << ',' << r.minSeconds << ','
+            << r.rowsPerSecond() << ',' << r.speedup << ',' << r.efficiency << '\n';
+    }
+}
+
+static void writeJson(const string& path, const vector<BenchmarkResult>& results, const BenchmarkOptions& options) {
+    ofstream out(path);
+    if (!out) throw runtime_error("Не удалось создать " + path);
+
+    out << setprecision(9);
+    out << "{\"hardwareThreads\":" << thread::hardware_concurrency() << ",\"warmup\":" << options.warmup
+        << ",\"repeat\":" << options.repeat << ",\"seed\":" << options.seed << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << (i ? "," : "") << "\n{\"path\":\"" << r.path << "\",\"schedule\":\"" << r.schedule
+            << "\",\"rows\":" << r.rows
+            << ",\"selectivity\":" << r.selectivity << ",\"matched\":" << r.matched << ",\"threads\":" << r.threads
+            << ",\"medianSeconds\":" << r.medianSeconds << ",\"p95Seconds\":" << r.p95Seconds
+            << ",\"minSeconds\":" << r.minSeconds << ",\"rowsPerSecond\":" << r.rowsPerSecond()
+            << ",\"speedup\":" << r.speedup << ",\"efficiency\":" << r.efficiency << "}";
+    }
+    out << "\n]}\n";
+}
+
+static void runBenchmark(const BenchmarkOptions& options) {
+    vector<ScanPath> paths;
+    for (auto& path : allScanPaths()) {
+        if (options.paths.empty() || find(options.paths.begin(), options.paths.end(), path.name) != options.paths.end()) {
+            paths.push_back(move(path));
+        }
+    }
+    if (paths.empty()) {
+        throw invalid_argument("Ни один путь просмотра не выбран");
+    }
+
+    // Пул на наибольшее число потоков; меньшие значения задают число задач запроса
+    int maxThreads = *max_element(options.threads.begin(), options.threads.end());
+    ThreadPool pool(maxThreads);
+
+    vector<BenchmarkResult> results;
+    cout << fixed;
+    for (size_t rows : options.sizes) {
+        cout << endl << "НАБОР " << rows << " СТРОК" << endl;
+        auto buildStart = chrono::steady_clock::now();
+        bool needIndexes = any_of(paths.begin(), paths.end(), [](const ScanPath& p) { return p.useIndexes; });
+        auto dataset = CarDataset::create(generateCars(rows, options.seed, pool), needIndexes, pool);
+        cout << "Подготовлен за " << setprecision(3)
+             << chrono::duration<double>(chrono::steady_clock::now() - buildStart).count() << " секунд" << endl;
+
+        CarProcessor processor(dataset, pool);
+        unique_ptr<CompressedCarTable> compressed;
+        if (any_of(paths.begin(), paths.end(), [](const ScanPath& p) { return p.needsCompressed; })) {
+            compressed = make_unique<CompressedCarTable>(*dataset, pool);
+            cout << "Сжатые колонки: " << setprecision(1)
+                 << 100.0 * compressed->memoryBytes() / max<size_t>(1, compressed->uncompressedBytes())
+                 << "% от исходных" << endl;
+        }
+        BenchmarkTarget target{processor, compressed.get()};
+        for (double selectivity : options.selectivities) {
+            CarCriteria criteria = criteriaForSelectivity(selectivity);
+            cout << endl << "Селективность " << setprecision(3) << selectivity * 100 << "%" << endl;
+            // Заголовок выровнен пробелами: setw считает байты, а не буквы кириллицы
+            cout << "путь             распред.    потоки  медиана,мс      p95,мс   млн строк/с    ускор.   эффект." << endl;
+
+            for (const auto& path : paths) for (ScanScheduling scheduling : options.schedules) {
+                // Однопоточным путям распределение безразлично
+                if (!path.multiThreaded && scheduling != options.schedules.front()) continue;
+                processor.setScanMode(path.mode);
+                processor.setUseIndexes(path.useIndexes);
+                processor.setScheduling(scheduling);
+
+                double baseSeconds = 0;
+                int baseThreads = 0;
+                for (int threads : options.threads) {
+                    if (!path.multiThreaded && threads != options.threads.front()) continue;
+
+                    BenchmarkResult result = measure(path, target, criteria, path.multiThreaded ? threads : 1, options);
+                    result.schedule = path.multiThreaded ? schedulingName(scheduling) : "-";
+                    result.rows = rows;
+                    result.selectivity = selectivity;
+                    // Базой служит первая точка пути (обычно один поток)
+                    if (baseThreads == 0) {
+                        baseSeconds = result.medianSeconds;
+                        baseThreads = result.threads;
+                    }
+                    result.speedup = result.medianSeconds > 0 ? baseSeconds / result.medianSeconds : 1.0;
+                    result.efficiency = result.speedup * baseThreads / result.threads;
+
+                    cout << left << setw(17) << result.path << setw(10) << result.schedule << right << setw(8) << result.threads << setprecision(3)
+                         << setw(12) << result.medianSeconds * 1e3 << setw(12) << result.p95Seconds * 1e3
+                         << setw(14) << result.rowsPerSecond() / 1e6 << setprecision(2) << setw(10) << result.speedup
+                         << setw(10) << result.efficiency << endl;
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (!options.csvPath.empty()) {
+        writeCsv(options.csvPath, results);
+        cout << endl << "CSV: " << options.csvPath << endl;
+    }
+    if (!options.jsonPath.empty()) {
+        writeJson(options.jsonPath, results, options);
+        cout << "JSON: " << options.jsonPath << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        runBenchmark(parseOptions(argc, argv));
+    } catch (const exception& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,24 +1,56 @@
 #pragma once
 #include <string>
 #include <iostream>
+#include <cstdint>
+#include "string_dictionary.h"
 using namespace std;
-// Структура для хранения информации об автомобиле
+
+// Номер строки в наборе автомобилей
+using RowId = uint32_t;
+
+// Критерии фильтрации автомобилей
+struct CarCriteria {
+    int minPrice;          // Минимальная цена
+    int maxPrice;          // Максимальная цена
+    int maxMileage;        // Максимальный пробег
+    int minYear;           // Минимальный год выпуска
+    int brandCode = -1;    // Код марки в brandDictionary(), -1 - любая
+    int bodyTypeCode = -1; // Код типа кузова в bodyTypeDictionary(), -1 - любой
+    
+    bool hasCodeFilter() const { return brandCode >= 0 || bodyTypeCode >= 0; }
+};
+
+// Структура для хранения информации об автомобиле.
+// Марка и тип кузова хранятся кодами словарей, строки лежат в словаре один раз.
 struct Car {
-    string brand;     // Марка автомобиля
     int price;             // Цена
     int mileage;           // Пробег
-    string bodyType;  // Тип кузова
     int year;              // Год выпуска
+    StringCode brand;      // Код марки автомобиля
+    StringCode bodyType;   // Код типа кузова
+    
+    Car() : price(0), mileage(0), year(0), brand(0), bodyType(0) {}
+    Car(StringCode b, int p, int m, StringCode bt, int y) : price(p), mileage(m), year(y), brand(b), bodyType(bt) {}
+    Car(const string& b, int p, int m, const string& bt, int y)
+        : Car(brandDictionary().intern(b), p, m, bodyTypeDictionary().intern(bt), y) {}
     
-    Car(const string& b, int p, int m, const string& bt, int y) : brand(b), price(p), mileage(m), bodyType(bt), year(y) {}
+    const string& brandName() const { return brandDictionary().name(brand); }
+    const string& bodyTypeName() const { return bodyTypeDictionary().name(bodyType); }
     
     // Метод для проверки соответствия критериям
     bool matchesCriteria(int minPrice, int maxPrice, int maxMileage, int minYear) const {
         return (price >= minPrice && price <= maxPrice) && (mileage <= maxMileage) && (year >= minYear);
     }
     
+    bool matchesCriteria(const CarCriteria& c) const {
+        // Марка и кузов сравниваются как целые числа, без сравнения строк
+        return matchesCriteria(c.minPrice, c.maxPrice, c.maxMileage, c.minYear) &&
+               (c.brandCode < 0 || brand == c.brandCode) &&
+               (c.bodyTypeCode < 0 || bodyType == c.bodyTypeCode);
+    }
+    
     // Метод для вывода информации об автомобиле
     void printInfo() const {
-        cout << brand << " | Цена: " << price << " | Пробег: " << mileage << " | Кузов: " << bodyType << " | Год: " << year << endl;
+        cout << brandName() << " | Цена: " << price << " | Пробег: " << mileage << " | Кузов: " << bodyTypeName() << " | Год: " << year << endl;
     }
-};
\ No newline at end of file
+};
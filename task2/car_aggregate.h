@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+
+// Агрегаты по подходящим строкам: считаются прямо в просмотре, без копирования автомобилей
+struct CarAggregate {
+    size_t count = 0;
+    long long sumPrice = 0;
+    long long sumMileage = 0;
+    int minPrice = INT_MAX, maxPrice = INT_MIN;
+    int minMileage = INT_MAX, maxMileage = INT_MIN;
+
+    void add(int price, int mileage) {
+        count++;
+        sumPrice += price;
+        sumMileage += mileage;
+        minPrice = min(minPrice, price);
+        maxPrice = max(maxPrice, price);
+        minMileage = min(minMileage, mileage);
+        maxMileage = max(maxMileage, mileage);
+    }
+
+    // Объединение частичных агрегатов двух задач
+    void merge(const CarAggregate& other) {
+        count += other.count;
+        sumPrice += other.sumPrice;
+        sumMileage += other.sumMileage;
+        minPrice = min(minPrice, other.minPrice);
+        maxPrice = max(maxPrice, other.maxPrice);
+        minMileage = min(minMileage, other.minMileage);
+        maxMileage = max(maxMileage, other.maxMileage);
+    }
+
+    double averagePrice() const { return count ? static_cast<double>(sumPrice) / count : 0.0; }
+    double averageMileage() const { return count ? static_cast<double>(sumMileage) / count : 0.0; }
+};
+
+// Поле группировки
+enum class GroupBy {
+    Brand,       // Ключ - код марки в brandDictionary()
+    BodyType,    // Ключ - код типа кузова в bodyTypeDictionary()
+    Year         // Ключ - год выпуска
+};
+
+// Одна группа результата: ключ и агрегаты ее строк
+struct CarGroup {
+    int key = 0;
+    CarAggregate aggregate;
+};
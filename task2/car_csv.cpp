@@ -0,0 +1,247 @@
+#include "car_csv.h"
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+// Минимальный размер диапазона: мелкие диапазоны не окупают накладные расходы
+static constexpr size_t kMinCsvRangeBytes = 1 << 20;
+
+// brand,price,mileage,bodyType,year
+static constexpr size_t kCsvFields = 5;
+
+// Результат разбора одного диапазона: колонки с локальными кодами словарей
+struct CsvRange {
+    CarColumns columns;
+    vector<string_view> brandValues;        // Локальный код -> строка (указывает в файл)
+    vector<string_view> bodyTypeValues;
+    deque<string> unescapedValues;          // Строки с "" внутри кавычек: в файле их нет в готовом виде
+    size_t skippedLines = 0;
+};
+
+// Локальный словарь диапазона: без блокировок и без копирования строк
+class LocalDictionary {
+private:
+    unordered_map<string_view, StringCode> codes;
+    vector<string_view>& values;
+    deque<string>& storage;
+    
+public:
+    LocalDictionary(vector<string_view>& values, deque<string>& storage) : values(values), storage(storage) {}
+    
+    // transient - value указывает во временный буфер, и новую строку нужно скопировать
+    StringCode intern(string_view value, bool transient) {
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+        // Иначе коды разных строк совпали бы, и при слиянии строки попали бы не в те коды словаря
+        if (values.size() > numeric_limits<StringCode>::max()) {
+            throw length_error("Словарь строк диапазона CSV переполнен");
+        }
+        if (transient) value = storage.emplace_back(value);
+        StringCode code = static_cast<StringCode>(values.size());
+        codes.emplace(value, code);
+        values.push_back(value);
+        return code;
+    }
+};
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static string_view trimField(string_view field) {
+    while (!field.empty() && isBlank(field.front())) field.remove_prefix(1);
+    while (!field.empty() && isBlank(field.back())) field.remove_suffix(1);
+    return field;
+}
+
+// Отрезает от line очередное поле. Запятые внутри кавычек не разделяют поля, "" внутри
+// кавычек - одна кавычка. Поле без "" указывает прямо в строку, иначе собирается в buffer.
+// last - поле было последним в строке; false - кавычка не закрыта или после нее не запятая.
+// Переводы строк внутри кавычек не поддерживаются: файл делится на диапазоны по строкам.
+static bool nextField(string_view& line, string_view& field, string& buffer, bool& last) {
+    buffer.clear();
+    size_t pos = 0;
+    while (pos < line.size() && isBlank(line[pos])) ++pos;
+    
+    if (pos == line.size() || line[pos] != '"') {
+        size_t comma = line.find(',');
+        last = comma == string_view::npos;
+        field = trimField(line.substr(0, comma));
+        line.remove_prefix(last ? line.size() : comma + 1);
+        return true;
+    }
+    
+    size_t start = ++pos;
+    bool escaped = false;
+    while (true) {
+        size_t quote = line.find('"', pos);
+        if (quote == string_view::npos) return false;
+        if (quote + 1 < line.size() && line[quote + 1] == '"') {
+            buffer.append(line.substr(pos, quote + 1 - pos));
+            escaped = true;
+            pos = quote + 2;
+            continue;
+        }
+        if (escaped) {
+            buffer.append(line.substr(pos, quote - pos));
+            field = buffer;
+        } else {
+            field = line.substr(start, quote - start);
+        }
+        pos = quote + 1;
+        break;
+    }
+    
+    while (pos < line.size() && isBlank(line[pos])) ++pos;
+    last = pos == line.size();
+    if (!last && line[pos] != ',') return false;
+    line.remove_prefix(last ? pos : pos + 1);
+    return true;
+}
+
+static bool parseInt(string_view field, int& value) {
+    auto [ptr, ec] = from_chars(field.data(), field.data() + field.size(), value);
+    return ec == errc() && ptr == field.data() + field.size();
+}
+
+// Разбирает одну строку CSV; false, если строка некорректна или в ней не ровно kCsvFields полей.
+// Поля с "" собираются в buffers и действительны до следующего вызова.
+static bool parseLine(string_view line, string (&buffers)[kCsvFields],
+                      string_view& brand, int& price, int& mileage, string_view& bodyType, int& year) {
+    string_view fields[kCsvFields];
+    size_t count = 0;
+    bool last = false;
+    while (!last) {
+        if (count == kCsvFields) return false;
+        if (!nextField(line, fields[count], buffers[count], last)) return false;
+        ++count;
+    }
+    if (count != kCsvFields) return false;
+    
+    brand = fields[0];
+    bodyType = fields[3];
+    return !brand.empty() && parseInt(fields[1], price) && parseInt(fields[2], mileage) && parseInt(fields[4], year);
+}
+
+static void parseRange(const char* begin, const char* end, CsvRange& range) {
+    LocalDictionary brands(range.brandValues, range.unescapedValues);
+    LocalDictionary bodyTypes(range.bodyTypeValues, range.unescapedValues);
+    CarColumns& columns = range.columns;
+    
+    // Грубая оценка числа строк, чтобы избежать многократных перераспределений
+    size_t estimate = static_cast<size_t>(end - begin) / 40;
+    columns.prices.reserve(estimate);
+    columns.mileages.reserve(estimate);
+    columns.years.reserve(estimate);
+    columns.brands.reserve(estimate);
+    columns.bodyTypes.reserve(estimate);
+    
+    string buffers[kCsvFields];
+    const char* pos = begin;
+    while (pos < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) lineEnd = end;
+        string_view line(pos, lineEnd - pos);
+        pos = lineEnd + 1;
+        
+        if (trimField(line).empty()) continue;
+        
+        string_view brand, bodyType;
+        int price, mileage, year;
+        if (!parseLine(line, buffers, brand, price, mileage, bodyType, year)) {
+            range.skippedLines++;
+            continue;
+        }
+        columns.prices.push_back(price);
+        columns.mileages.push_back(mileage);
+        columns.years.push_back(year);
+        columns.brands.push_back(brands.intern(brand, brand.data() == buffers[0].data()));
+        columns.bodyTypes.push_back(bodyTypes.intern(bodyType, bodyType.data() == buffers[3].data()));
+    }
+}
+
+// Пропускает первую строку, если в ней нет числа на месте цены (заголовок)
+static const char* skipHeader(const char* begin, const char* end) {
+    const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (!lineEnd) lineEnd = end;
+    
+    string buffers[kCsvFields];
+    string_view brand, bodyType;
+    int price, mileage, year;
+    if (parseLine(string_view(begin, lineEnd - begin), buffers, brand, price, mileage, bodyType, year)) {
+        return begin;
+    }
+    return lineEnd < end ? lineEnd + 1 : end;
+}
+
+shared_ptr<const CarDataset> loadCarsCsv(const string& path, bool buildIndexes, ThreadPool& pool, CsvLoadStats* stats) {
+    auto started = chrono::steady_clock::now();
+    MappedFile file(path);
+    const char* fileBegin = file.getData();
+    const char* fileEnd = fileBegin + file.size();
+    const char* dataBegin = file.size() ? skipHeader(fileBegin, fileEnd) : fileEnd;
+    
+    // Делим файл на диапазоны; каждая граница сдвигается за ближайший перевод строки
+    size_t bytes = static_cast<size_t>(fileEnd - dataBegin);
+    size_t numRanges = max<size_t>(1, min<size_t>(pool.getThreadCount() * 4, bytes / kMinCsvRangeBytes));
+    vector<const char*> bounds(numRanges + 1);
+    bounds[0] = dataBegin;
+    bounds[numRanges] = fileEnd;
+    for (size_t i = 1; i < numRanges; ++i) {
+        const char* guess = max(dataBegin + bytes * i / numRanges, bounds[i - 1]);
+        const char* newline = static_cast<const char*>(memchr(guess, '\n', fileEnd - guess));
+        bounds[i] = newline ? newline + 1 : fileEnd;
+    }
+    
+    vector<CsvRange> ranges(numRanges);
+    pool.parallelFor(numRanges, [&](size_t i) {
+        parseRange(bounds[i], bounds[i + 1], ranges[i]);
+    });
+    
+    // Локальные коды переводятся в коды общих словарей: различных строк мало,
+    // поэтому общий словарь блокируется всего несколько раз на диапазон
+    vector<vector<StringCode>> brandRemap(numRanges), bodyTypeRemap(numRanges);
+    vector<size_t> offsets(numRanges + 1, 0);
+    size_t skipped = 0;
+    for (size_t i = 0; i < numRanges; ++i) {
+        for (string_view value : ranges[i].brandValues) brandRemap[i].push_back(brandDictionary().intern(value));
+        for (string_view value : ranges[i].bodyTypeValues) bodyTypeRemap[i].push_back(bodyTypeDictionary().intern(value));
+        offsets[i + 1] = ranges[i].columns.size();
+        skipped += ranges[i].skippedLines;
+    }
+    inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    
+    // Склейка диапазонов в итоговые колонки по префиксным суммам, параллельно
+    CarColumns columns;
+    columns.resize(offsets[numRanges]);
+    pool.parallelFor(numRanges, [&](size_t i) {
+        const CarColumns& part = ranges[i].columns;
+        size_t base = offsets[i];
+        copy(part.prices.begin(), part.prices.end(), columns.prices.begin() + base);
+        copy(part.mileages.begin(), part.mileages.end(), columns.mileages.begin() + base);
+        copy(part.years.begin(), part.years.end(), columns.years.begin() + base);
+        for (size_t j = 0; j < part.size(); ++j) {
+            columns.brands[base + j] = brandRemap[i][part.brands[j]];
+            columns.bodyTypes[base + j] = bodyTypeRemap[i][part.bodyTypes[j]];
+        }
+    });
+    ranges.clear();
+    
+    auto dataset = CarDataset::create(move(columns), buildIndexes, pool);
+    if (stats) {
+        stats->rows = dataset->size();
+        stats->skippedLines = skipped;
+        stats->ranges = numRanges;
+        stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    }
+    return dataset;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <memory>
+#include "car_dataset.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Итоги загрузки CSV
+struct CsvLoadStats {
+    size_t rows = 0;             // Загружено строк
+    size_t skippedLines = 0;     // Пропущено некорректных строк
+    size_t ranges = 0;           // На сколько диапазонов был разбит файл
+    double seconds = 0.0;
+};
+
+// Параллельная загрузка CSV с колонками brand,price,mileage,bodyType,year.
+// Файл отображается в память и делится на диапазоны байт по границам строк;
+// каждый диапазон разбирается своей задачей пула без выделения string на поле.
+// Поля могут быть в кавычках: "Mercedes, AMG" и "" внутри кавычек разбираются как в RFC 4180,
+// но перевод строки внутри кавычек не допускается. Строки не из пяти полей считаются некорректными
+// и учитываются в skippedLines.
+// Первая строка пропускается, если это заголовок. Бросает runtime_error, если файл не открыть.
+shared_ptr<const CarDataset> loadCarsCsv(const string& path, bool buildIndexes = false,
+                                         ThreadPool& pool = ThreadPool::shared(),
+                                         CsvLoadStats* stats = nullptr);
@@ -0,0 +1,88 @@
+#include "car_dataset.h"
+#include <atomic>
+
+using namespace std;
+
+// Счетчик номеров снимков на весь процесс
+static atomic<uint64_t> g_nextDatasetVersion{1};
+
+CarDataset::CarDataset() : version(g_nextDatasetVersion++) {}
+
+void CarDataset::buildIndexes(ThreadPool& pool) {
+    // Индексы независимы, строим их параллельно
+    pool.parallelFor(3, [this](size_t i) {
+        if (i == 0) priceIndex = SortedColumnIndex(prices);
+        else if (i == 1) mileageIndex = SortedColumnIndex(mileages);
+        else yearIndex = SortedColumnIndex(years);
+    });
+    indexed = true;
+}
+
+void CarDataset::adoptColumns(CarColumns&& columns, ThreadPool& pool) {
+    size_t n = columns.size();
+    rowCount = n;
+    ownedPrices = move(columns.prices);
+    ownedMileages = move(columns.mileages);
+    ownedYears = move(columns.years);
+    ownedBrands = move(columns.brands);
+    ownedBodyTypes = move(columns.bodyTypes);
+    ownedZones.assign((n + kBlockRows - 1) / kBlockRows, ZoneMap());
+    
+    // Зонные карты блоков независимы
+    pool.parallelFor(ownedZones.size(), [this, n](size_t block) {
+        size_t end = min((block + 1) * kBlockRows, n);
+        for (size_t i = block * kBlockRows; i < end; ++i) {
+            ownedZones[block].add(ownedPrices[i], ownedMileages[i], ownedYears[i]);
+        }
+    });
+    
+    prices = ownedPrices;
+    mileages = ownedMileages;
+    years = ownedYears;
+    brands = ownedBrands;
+    bodyTypes = ownedBodyTypes;
+    zones = ownedZones;
+    for (const auto& zone : zones) {
+        totals.merge(zone);
+    }
+}
+
+shared_ptr<const CarDataset> CarDataset::create(vector<Car>&& source, bool buildIndexes, ThreadPool& pool) {
+    shared_ptr<CarDataset> data(new CarDataset());
+    data->cars = move(source);
+    
+    // Раскладываем поля по колонкам, блоки независимы
+    const vector<Car>& cars = data->cars;
+    size_t n = cars.size();
+    CarColumns columns;
+    columns.resize(n);
+    pool.parallelFor((n + kBlockRows - 1) / kBlockRows, [&](size_t block) {
+        size_t end = min((block + 1) * kBlockRows, n);
+        for (size_t i = block * kBlockRows; i < end; ++i) {
+            columns.prices[i] = cars[i].price;
+            columns.mileages[i] = cars[i].mileage;
+            columns.years[i] = cars[i].year;
+            columns.brands[i] = cars[i].brand;
+            columns.bodyTypes[i] = cars[i].bodyType;
+        }
+    });
+    data->adoptColumns(move(columns), pool);
+    
+    if (buildIndexes) {
+        data->buildIndexes(pool);
+    }
+    return data;
+}
+
+shared_ptr<const CarDataset> CarDataset::create(CarColumns&& columns, bool buildIndexes, ThreadPool& pool) {
+    shared_ptr<CarDataset> data(new CarDataset());
+    data->adoptColumns(move(columns), pool);
+    if (buildIndexes) {
+        data->buildIndexes(pool);
+    }
+    return data;
+}
+
+size_t CarDataset::getIndexMemoryBytes() const {
+    return priceIndex.memoryBytes() + mileageIndex.memoryBytes() + yearIndex.memoryBytes();
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <span>
+#include <cstdint>
+#include "car.h"
+#include "car_index.h"
+#include "zone_map.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Колонки набора, собранные без промежуточного vector<Car> (например, загрузчиком CSV)
+struct CarColumns {
+    vector<int> prices;
+    vector<int> mileages;
+    vector<int> years;
+    vector<StringCode> brands;
+    vector<StringCode> bodyTypes;
+    
+    size_t size() const { return prices.size(); }
+    void resize(size_t n) {
+        prices.resize(n);
+        mileages.resize(n);
+        years.resize(n);
+        brands.resize(n);
+        bodyTypes.resize(n);
+    }
+};
+
+// Неизменяемый снимок набора автомобилей.
+// Создается один раз, затем разделяется через shared_ptr между любым числом
+// процессоров и запросов, которые читают его одновременно без блокировок.
+// Колонки либо принадлежат снимку, либо указывают прямо в отображенный файл.
+class CarDataset {
+private:
+    vector<Car> cars;        // Строковое представление (пусто для отображенного файла)
+    size_t rowCount = 0;
+    
+    // Собственное хранилище колонок
+    vector<int> ownedPrices;
+    vector<int> ownedMileages;
+    vector<int> ownedYears;
+    vector<StringCode> ownedBrands;
+    vector<StringCode> ownedBodyTypes;
+    vector<ZoneMap> ownedZones;
+    
+    // Колоночное представление полей, участвующих в фильтре
+    span<const int> prices;
+    span<const int> mileages;
+    span<const int> years;
+    span<const StringCode> brands;
+    span<const StringCode> bodyTypes;
+    
+    // Зонные карты: min/max по блокам из kBlockRows строк
+    span<const ZoneMap> zones;
+    ZoneMap totals;          // min/max по всему набору
+    
+    unique_ptr<MappedFile> mapping;
+    
+    // Необязательные вторичные индексы
+    bool indexed = false;
+    SortedColumnIndex priceIndex;
+    SortedColumnIndex mileageIndex;
+    SortedColumnIndex yearIndex;
+    
+    uint64_t version;        // Уникальный номер снимка
+    
+    CarDataset();
+    void buildIndexes(ThreadPool& pool);
+    
+    // Привязывает спаны к собственным колонкам и считает зонные карты
+    void adoptColumns(CarColumns&& columns, ThreadPool& pool);
+    
+public:
+    // Размер блока зонных карт и колоночного просмотра
+    static constexpr size_t kBlockRows = 4096;
+    
+    // Забирает вектор без копирования и строит колонки, зонные карты и (по желанию) индексы
+    static shared_ptr<const CarDataset> create(vector<Car>&& cars, bool buildIndexes = false,
+                                               ThreadPool& pool = ThreadPool::shared());
+    
+    // Забирает готовые колонки; массива структур у такого снимка нет
+    static shared_ptr<const CarDataset> create(CarColumns&& columns, bool buildIndexes = false,
+                                               ThreadPool& pool = ThreadPool::shared());
+    
+    // Отображает файл формата car_file.h и работает с колонками на месте, без разбора и копирования.
+    // Бросает runtime_error, если заголовок поврежден, код марки/кузова выходит за словарь файла
+    // или зонные карты не совпадают с колонками (проверка - один проход по числовым колонкам).
+    static shared_ptr<const CarDataset> mapFile(const string& path, bool buildIndexes = false,
+                                                ThreadPool& pool = ThreadPool::shared());
+    
+    // Записывает снимок в двоичный формат car_file.h
+    void writeFile(const string& path) const;
+    
+    CarDataset(const CarDataset&) = delete;
+    CarDataset& operator=(const CarDataset&) = delete;
+    
+    size_t size() const { return rowCount; }
+    
+    // Автомобиль собирается из колонок, поэтому работает и для отображенного файла
+    Car operator[](size_t row) const { return Car(brands[row], prices[row], mileages[row], bodyTypes[row], years[row]); }
+    
+    // Массив структур есть только у снимков, созданных из vector<Car>
+    bool hasRows() const { return !cars.empty() || rowCount == 0; }
+    const vector<Car>& getCars() const { return cars; }
+    
+    const int* getPrices() const { return prices.data(); }
+    const int* getMileages() const { return mileages.data(); }
+    const int* getYears() const { return years.data(); }
+    const StringCode* getBrands() const { return brands.data(); }
+    const StringCode* getBodyTypes() const { return bodyTypes.data(); }
+    
+    const ZoneMap& getZone(size_t block) const { return zones[block]; }
+    size_t getBlockCount() const { return zones.size(); }
+    const ZoneMap& getTotals() const { return totals; }
+    
+    bool isMapped() const { return mapping != nullptr; }
+    
+    bool hasIndexes() const { return indexed; }
+    const SortedColumnIndex& getPriceIndex() const { return priceIndex; }
+    const SortedColumnIndex& getMileageIndex() const { return mileageIndex; }
+    const SortedColumnIndex& getYearIndex() const { return yearIndex; }
+    size_t getIndexMemoryBytes() const;
+    
+    uint64_t getVersion() const { return version; }
+};
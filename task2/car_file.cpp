@@ -0,0 +1,208 @@
+#include "car_dataset.h"
+#include "car_file.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <atomic>
+#include <limits>
+
+using namespace std;
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + kCarFileAlignment - 1) / kCarFileAlignment * kCarFileAlignment;
+}
+
+static void writeAt(ofstream& out, uint64_t offset, const void* bytes, size_t length) {
+    out.seekp(static_cast<streamoff>(offset));
+    out.write(static_cast<const char*>(bytes), static_cast<streamsize>(length));
+}
+
+// Записывает словарь целиком: коды файла совпадают с кодами словаря процесса-писателя
+static uint64_t writeDictionary(ofstream& out, uint64_t offset, const StringDictionary& dictionary, uint64_t& count) {
+    count = dictionary.size();
+    out.seekp(static_cast<streamoff>(offset));
+    for (uint64_t code = 0; code < count; ++code) {
+        const string& value = dictionary.name(static_cast<StringCode>(code));
+        uint32_t length = static_cast<uint32_t>(value.size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(value.data(), length);
+        offset += sizeof(length) + length;
+    }
+    return offset;
+}
+
+void CarDataset::writeFile(const string& path) const {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        throw runtime_error("Не удалось создать " + path);
+    }
+    
+    CarFileHeader header{};
+    memcpy(header.magic, kCarFileMagic, sizeof(header.magic));
+    header.formatVersion = kCarFileVersion;
+    header.blockRows = kBlockRows;
+    header.rowCount = rowCount;
+    header.blockCount = zones.size();
+    header.totals = totals;
+    
+    uint64_t offset = alignUp(sizeof(CarFileHeader));
+    header.priceOffset = offset;
+    offset = alignUp(offset + rowCount * sizeof(int));
+    header.mileageOffset = offset;
+    offset = alignUp(offset + rowCount * sizeof(int));
+    header.yearOffset = offset;
+    offset = alignUp(offset + rowCount * sizeof(int));
+    header.brandOffset = offset;
+    offset = alignUp(offset + rowCount * sizeof(StringCode));
+    header.bodyTypeOffset = offset;
+    offset = alignUp(offset + rowCount * sizeof(StringCode));
+    header.zoneOffset = offset;
+    offset = alignUp(offset + zones.size() * sizeof(ZoneMap));
+    
+    writeAt(out, header.priceOffset, prices.data(), prices.size_bytes());
+    writeAt(out, header.mileageOffset, mileages.data(), mileages.size_bytes());
+    writeAt(out, header.yearOffset, years.data(), years.size_bytes());
+    writeAt(out, header.brandOffset, brands.data(), brands.size_bytes());
+    writeAt(out, header.bodyTypeOffset, bodyTypes.data(), bodyTypes.size_bytes());
+    writeAt(out, header.zoneOffset, zones.data(), zones.size_bytes());
+    
+    header.brandDictOffset = offset;
+    offset = alignUp(writeDictionary(out, offset, brandDictionary(), header.brandDictCount));
+    header.bodyTypeDictOffset = offset;
+    offset = writeDictionary(out, offset, bodyTypeDictionary(), header.bodyTypeDictCount);
+    header.fileSize = offset;
+    
+    writeAt(out, 0, &header, sizeof(header));
+    if (!out) {
+        throw runtime_error("Ошибка записи " + path);
+    }
+}
+
+bool loadCarFileDictionary(const char* data, size_t size, uint64_t offset, uint64_t count,
+                           StringDictionary& dictionary, vector<StringCode>& remap) {
+    // Каждая строка словаря занимает хотя бы 4 байта длины: так поврежденное число строк
+    // не превратится в огромное выделение памяти
+    if (offset > size || count > (size - offset) / sizeof(uint32_t)) {
+        throw runtime_error("Поврежден словарь в файле автомобилей");
+    }
+    remap.resize(count);
+    bool identity = true;
+    for (uint64_t code = 0; code < count; ++code) {
+        uint32_t length;
+        if (offset + sizeof(length) > size) throw runtime_error("Поврежден словарь в файле автомобилей");
+        memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        if (offset + length > size) throw runtime_error("Поврежден словарь в файле автомобилей");
+        
+        remap[code] = dictionary.intern(string_view(data + offset, length));
+        identity = identity && remap[code] == code;
+        offset += length;
+    }
+    return identity;
+}
+
+void validateCarFileHeader(const CarFileHeader& header, uint64_t fileSize, const string& path) {
+    if (memcmp(header.magic, kCarFileMagic, sizeof(header.magic)) != 0 || header.formatVersion != kCarFileVersion) {
+        throw runtime_error(path + ": неизвестный формат файла автомобилей");
+    }
+    
+    // Каждая секция должна целиком лежать в файле и быть выровнена
+    auto fits = [&](uint64_t offset, uint64_t bytes) {
+        return offset % kCarFileAlignment == 0 && offset <= fileSize && bytes <= fileSize - offset;
+    };
+    // Номера строк - RowId (uint32_t)
+    if (header.rowCount > numeric_limits<RowId>::max()) {
+        throw runtime_error(path + ": строк больше, чем помещается в RowId");
+    }
+    const uint64_t blockRows = CarDataset::kBlockRows;
+    uint64_t n4 = header.rowCount * sizeof(int);
+    uint64_t n2 = header.rowCount * sizeof(StringCode);
+    if (header.blockRows != blockRows || header.fileSize > fileSize ||
+        header.blockCount != (header.rowCount + blockRows - 1) / blockRows ||
+        !fits(header.priceOffset, n4) || !fits(header.mileageOffset, n4) || !fits(header.yearOffset, n4) ||
+        !fits(header.brandOffset, n2) || !fits(header.bodyTypeOffset, n2) ||
+        !fits(header.zoneOffset, header.blockCount * sizeof(ZoneMap)) ||
+        header.brandDictOffset > header.bodyTypeDictOffset || header.bodyTypeDictOffset > header.fileSize) {
+        throw runtime_error(path + ": несовместимый или поврежденный заголовок");
+    }
+}
+
+shared_ptr<const CarDataset> CarDataset::mapFile(const string& path, bool buildIndexes, ThreadPool& pool) {
+    auto file = make_unique<MappedFile>(path);
+    
+    CarFileHeader header;
+    if (file->size() < sizeof(header)) {
+        throw runtime_error(path + ": файл слишком мал для заголовка");
+    }
+    memcpy(&header, file->getData(), sizeof(header));
+    validateCarFileHeader(header, file->size(), path);
+    
+    shared_ptr<CarDataset> data(new CarDataset());
+    CarDataset& d = *data;
+    const char* base = file->getData();
+    size_t n = header.rowCount;
+    
+    // Числовые колонки и зонные карты указывают прямо в отображенную память
+    d.rowCount = n;
+    d.prices = span<const int>(reinterpret_cast<const int*>(base + header.priceOffset), n);
+    d.mileages = span<const int>(reinterpret_cast<const int*>(base + header.mileageOffset), n);
+    d.years = span<const int>(reinterpret_cast<const int*>(base + header.yearOffset), n);
+    d.zones = span<const ZoneMap>(reinterpret_cast<const ZoneMap*>(base + header.zoneOffset), header.blockCount);
+    d.totals = header.totals;
+    
+    // Зонные карты и итоги из файла должны совпадать с колонками: по ним отбрасываются блоки,
+    // а aggregateBy(Year) размечает группы по totals. Проверка - один проход по числовым колонкам.
+    atomic<bool> zonesMismatch{false};
+    pool.parallelFor(header.blockCount, [&](size_t block) {
+        ZoneMap actual;
+        size_t end = min((block + 1) * kBlockRows, n);
+        for (size_t i = block * kBlockRows; i < end; ++i) {
+            actual.add(d.prices[i], d.mileages[i], d.years[i]);
+        }
+        if (!(actual == d.zones[block])) zonesMismatch = true;
+    });
+    ZoneMap totals;
+    for (const ZoneMap& zone : d.zones) {
+        totals.merge(zone);
+    }
+    if (zonesMismatch || !(totals == d.totals)) {
+        throw runtime_error(path + ": зонные карты или итоги не совпадают с колонками");
+    }
+    
+    // Коды марок и кузовов используются на месте, если словари файла совпадают со словарями процесса,
+    // иначе перекодируются в собственные колонки (2 байта на строку)
+    vector<StringCode> brandRemap, bodyTypeRemap;
+    bool brandIdentity = loadCarFileDictionary(base, file->size(), header.brandDictOffset, header.brandDictCount,
+                                               brandDictionary(), brandRemap);
+    bool bodyTypeIdentity = loadCarFileDictionary(base, file->size(), header.bodyTypeDictOffset, header.bodyTypeDictCount,
+                                                  bodyTypeDictionary(), bodyTypeRemap);
+    
+    // Код вне словаря файла - признак повреждения: подменять его нельзя, иначе запросы молча ошибутся
+    auto mapCodes = [&](uint64_t offset, bool identity, const vector<StringCode>& remap,
+                        vector<StringCode>& owned, span<const StringCode>& column) {
+        const StringCode* mapped = reinterpret_cast<const StringCode*>(base + offset);
+        atomic<bool> invalid{false};
+        if (!identity) owned.resize(n);
+        pool.parallelFor((n + kBlockRows - 1) / kBlockRows, [&](size_t block) {
+            size_t end = min((block + 1) * kBlockRows, n);
+            bool bad = false;
+            for (size_t i = block * kBlockRows; i < end; ++i) {
+                bad |= mapped[i] >= remap.size();
+                if (!identity) owned[i] = mapped[i] < remap.size() ? remap[mapped[i]] : 0;
+            }
+            if (bad) invalid = true;
+        });
+        if (invalid) {
+            throw runtime_error(path + ": код марки или кузова вне словаря файла");
+        }
+        column = identity ? span<const StringCode>(mapped, n) : span<const StringCode>(owned);
+    };
+    mapCodes(header.brandOffset, brandIdentity, brandRemap, d.ownedBrands, d.brands);
+    mapCodes(header.bodyTypeOffset, bodyTypeIdentity, bodyTypeRemap, d.ownedBodyTypes, d.bodyTypes);
+    
+    d.mapping = move(file);
+    if (buildIndexes) {
+        d.buildIndexes(pool);
+    }
+    return data;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "zone_map.h"
+#include "string_dictionary.h"
+
+using namespace std;
+
+// Двоичный формат набора автомобилей (порядок байт платформы).
+//
+//   CarFileHeader
+//   price, mileage, year          - int32 по rowCount значений
+//   brand, bodyType               - uint16 коды словарей
+//   зонные карты                  - ZoneMap по blockCount значений
+//   словари марок и типов кузова  - для каждой строки uint32 длина и байты
+//
+// Каждая секция начинается с границы kCarFileAlignment, поэтому колонки
+// читаются прямо из отображенной памяти без разбора и копирования.
+
+static constexpr char kCarFileMagic[8] = {'C', 'A', 'R', 'D', 'A', 'T', 'A', '1'};
+static constexpr uint32_t kCarFileVersion = 1;
+static constexpr uint64_t kCarFileAlignment = 64;
+
+struct CarFileHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t blockRows;           // Размер блока зонных карт
+    uint64_t rowCount;
+    uint64_t blockCount;
+    ZoneMap totals;               // min/max по всему набору
+    
+    uint64_t priceOffset;
+    uint64_t mileageOffset;
+    uint64_t yearOffset;
+    uint64_t brandOffset;
+    uint64_t bodyTypeOffset;
+    uint64_t zoneOffset;
+    uint64_t brandDictOffset;
+    uint64_t brandDictCount;
+    uint64_t bodyTypeDictOffset;
+    uint64_t bodyTypeDictCount;
+    uint64_t fileSize;
+};
+
+// Проверяет сигнатуру, версию, число строк (не больше, чем помещается в RowId), то,
+// что каждая секция целиком лежит в файле размером fileSize, и что словари идут по порядку:
+// brandDictOffset <= bodyTypeDictOffset <= header.fileSize <= fileSize.
+// Бросает runtime_error с путем в сообщении.
+void validateCarFileHeader(const CarFileHeader& header, uint64_t fileSize, const string& path);
+
+// Читает count строк словаря, начиная с offset в буфере [data, data + size),
+// и переводит коды файла в коды dictionary. Возвращает true, если перевод тождественный.
+bool loadCarFileDictionary(const char* data, size_t size, uint64_t offset, uint64_t count,
+                           StringDictionary& dictionary, vector<StringCode>& remap);
@@ -0,0 +1,113 @@
+#include "car_generator.h"
+#include <random>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+static const char* const kBrands[] = {"Toyota", "Honda", "BMW", "Audi", "Ford",
+                                      "Mercedes", "Volkswagen", "Hyundai", "Kia",
+                                      "Nissan", "Mazda", "Subaru", "Lexus", "Volvo",
+                                      "Chevrolet", "Renault", "Peugeot", "Skoda", "Citroen"};
+static const char* const kBodyTypes[] = {"Седан", "Хэтчбек", "Внедорожник",
+                                         "Кроссовер", "Универсал", "Купе", "Минивэн", "Пикап"};
+
+static constexpr int kBrandCount = sizeof(kBrands) / sizeof(kBrands[0]);
+static constexpr int kBodyTypeCount = sizeof(kBodyTypes) / sizeof(kBodyTypes[0]);
+static constexpr int kModelCount = 25;
+
+// Коды словарей для всех сочетаний "марка + модель" и типов кузова.
+// Строки добавляются в словари один раз и в фиксированном порядке.
+struct GeneratorCodes {
+    StringCode brandModel[kBrandCount][kModelCount];
+    StringCode bodyType[kBodyTypeCount];
+    
+    GeneratorCodes() {
+        for (int b = 0; b < kBrandCount; ++b) {
+            for (int m = 0; m < kModelCount; ++m) {
+                brandModel[b][m] = brandDictionary().intern(string(kBrands[b]) + " Model-" + to_string(2000 + m));
+            }
+        }
+        for (int t = 0; t < kBodyTypeCount; ++t) {
+            bodyType[t] = bodyTypeDictionary().intern(kBodyTypes[t]);
+        }
+    }
+};
+
+static const GeneratorCodes& generatorCodes() {
+    static const GeneratorCodes codes;
+    return codes;
+}
+
+// SplitMix64: перемешивает (seed, номер блока) в независимые зерна
+static uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+void CarDataStats::add(const Car& car) {
+    count++;
+    minPrice = min(minPrice, car.price);
+    maxPrice = max(maxPrice, car.price);
+    minYear = min(minYear, car.year);
+    maxYear = max(maxYear, car.year);
+    totalMileage += car.mileage;
+}
+
+void CarDataStats::merge(const CarDataStats& other) {
+    count += other.count;
+    minPrice = min(minPrice, other.minPrice);
+    maxPrice = max(maxPrice, other.maxPrice);
+    minYear = min(minYear, other.minYear);
+    maxYear = max(maxYear, other.maxYear);
+    totalMileage += other.totalMileage;
+}
+
+vector<Car> generateCars(size_t count, uint64_t seed, ThreadPool& pool) {
+    const GeneratorCodes& codes = generatorCodes();
+    vector<Car> cars(count);
+    size_t numBlocks = (count + kGeneratorBlockRows - 1) / kGeneratorBlockRows;
+    
+    pool.parallelFor(numBlocks, [&](size_t block) {
+        mt19937_64 gen(splitMix64(seed ^ splitMix64(block)));
+        uniform_int_distribution<> brandDist(0, kBrandCount - 1);
+        uniform_int_distribution<> priceDist(5000, 100000);
+        uniform_int_distribution<> mileageDist(0, 300000);
+        uniform_int_distribution<> bodyDist(0, kBodyTypeCount - 1);
+        uniform_int_distribution<> yearDist(1990, 2024);
+        
+        size_t start = block * kGeneratorBlockRows;
+        size_t end = min(start + kGeneratorBlockRows, count);
+        for (size_t i = start; i < end; ++i) {
+            StringCode brand = codes.brandModel[brandDist(gen)][i % kModelCount];
+            int price = priceDist(gen);
+            int mileage = mileageDist(gen);
+            StringCode bodyType = codes.bodyType[bodyDist(gen)];
+            int year = yearDist(gen);
+            cars[i] = Car(brand, price, mileage, bodyType, year);
+        }
+    });
+    
+    return cars;
+}
+
+CarDataStats computeStats(const vector<Car>& cars, ThreadPool& pool) {
+    size_t numBlocks = (cars.size() + kGeneratorBlockRows - 1) / kGeneratorBlockRows;
+    vector<CarDataStats> partial(numBlocks);
+    
+    pool.parallelFor(numBlocks, [&](size_t block) {
+        size_t start = block * kGeneratorBlockRows;
+        size_t end = min(start + kGeneratorBlockRows, cars.size());
+        for (size_t i = start; i < end; ++i) {
+            partial[block].add(cars[i]);
+        }
+    });
+    
+    CarDataStats stats;
+    for (const auto& part : partial) {
+        stats.merge(part);
+    }
+    return stats;
+}
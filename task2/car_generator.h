@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include "car.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Сводная статистика по набору автомобилей
+struct CarDataStats {
+    size_t count = 0;
+    int minPrice = INT_MAX, maxPrice = INT_MIN;
+    int minYear = INT_MAX, maxYear = INT_MIN;
+    long long totalMileage = 0;      // 64 бита: сумма 10M пробегов не помещается в int
+    
+    void add(const Car& car);
+    void merge(const CarDataStats& other);
+    double averageMileage() const { return count ? static_cast<double>(totalMileage) / count : 0.0; }
+};
+
+// Строк в одном независимом потоке случайных чисел
+static constexpr size_t kGeneratorBlockRows = 65536;
+
+// Генерирует count автомобилей параллельно.
+// Каждый блок из kGeneratorBlockRows строк получает собственный генератор, зерно которого
+// выводится из seed и номера блока, поэтому одно и то же seed дает один и тот же набор
+// при любом числе потоков.
+vector<Car> generateCars(size_t count, uint64_t seed, ThreadPool& pool = ThreadPool::shared());
+
+// Статистика считается параллельной редукцией по блокам
+CarDataStats computeStats(const vector<Car>& cars, ThreadPool& pool = ThreadPool::shared());
@@ -0,0 +1,50 @@
+#include "car_index.h"
+#include <algorithm>
+
+using namespace std;
+
+SortedColumnIndex::SortedColumnIndex(span<const int> column) {
+    size_t n = column.size();
+    if (n == 0) return;
+    
+    auto [minIt, maxIt] = minmax_element(column.begin(), column.end());
+    long long minValue = *minIt;
+    long long span = static_cast<long long>(*maxIt) - minValue + 1;
+    
+    keys.resize(n);
+    rows.resize(n);
+    
+    if (span <= static_cast<long long>(4 * n + 1024)) {
+        // Узкий диапазон значений (год, цена): сортировка подсчетом по гистограмме значений, O(n)
+        vector<size_t> offsets(span + 1, 0);
+        for (int value : column) {
+            offsets[value - minValue + 1]++;
+        }
+        for (long long v = 0; v < span; ++v) {
+            offsets[v + 1] += offsets[v];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t pos = offsets[column[i] - minValue]++;
+            keys[pos] = column[i];
+            rows[pos] = static_cast<RowId>(i);
+        }
+    } else {
+        // Широкий диапазон: обычная сортировка пар (значение, строка)
+        vector<pair<int, RowId>> entries(n);
+        for (size_t i = 0; i < n; ++i) {
+            entries[i] = {column[i], static_cast<RowId>(i)};
+        }
+        sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < n; ++i) {
+            keys[i] = entries[i].first;
+            rows[i] = entries[i].second;
+        }
+    }
+}
+
+pair<size_t, size_t> SortedColumnIndex::range(int lo, int hi) const {
+    if (lo > hi) return {0, 0};
+    size_t first = lower_bound(keys.begin(), keys.end(), lo) - keys.begin();
+    size_t last = upper_bound(keys.begin(), keys.end(), hi) - keys.begin();
+    return {first, max(first, last)};
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <span>
+#include "car.h"
+
+using namespace std;
+
+// Вторичный индекс по одному числовому полю: строки, упорядоченные по значению.
+// Внутри одинаковых значений строки идут по возрастанию номера.
+class SortedColumnIndex {
+private:
+    vector<int> keys;      // Значения поля по возрастанию
+    vector<RowId> rows;    // Номера строк в том же порядке
+    
+public:
+    SortedColumnIndex() = default;
+    explicit SortedColumnIndex(span<const int> column);
+    
+    bool empty() const { return rows.empty(); }
+    size_t size() const { return rows.size(); }
+    
+    // Позиции [first, last) в индексе для значений из [lo, hi]
+    pair<size_t, size_t> range(int lo, int hi) const;
+    
+    size_t countInRange(int lo, int hi) const {
+        auto [first, last] = range(lo, hi);
+        return last - first;
+    }
+    
+    RowId rowAt(size_t position) const { return rows[position]; }
+    
+    size_t memoryBytes() const { return keys.size() * sizeof(int) + rows.size() * sizeof(RowId); }
+};
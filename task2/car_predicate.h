@@ -0,0 +1,175 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <concepts>
+#include "car.h"
+#include "zone_map.h"
+
+using namespace std;
+
+// Составные условия над колонками снимка.
+// Форма выражения задается типом (например, And<Range<Price>, In<BodyType, 2>>), поэтому компилятор
+// разворачивает его в одну функцию без виртуальных вызовов и обхода дерева для каждой строки.
+// Условия вычисляются через & и |, а не && и ||, чтобы проверка строки шла без ветвлений.
+
+enum class CarField {
+    Price,
+    Mileage,
+    Year,
+    Brand,      // Код в brandDictionary()
+    BodyType    // Код в bodyTypeDictionary()
+};
+
+// Указатели на колонки, по которым проверяются условия
+struct CarColumnsView {
+    const int* prices = nullptr;
+    const int* mileages = nullptr;
+    const int* years = nullptr;
+    const StringCode* brands = nullptr;
+    const StringCode* bodyTypes = nullptr;
+};
+
+template <CarField F>
+inline int fieldValue(const CarColumnsView& cols, size_t i) {
+    if constexpr (F == CarField::Price) return cols.prices[i];
+    else if constexpr (F == CarField::Mileage) return cols.mileages[i];
+    else if constexpr (F == CarField::Year) return cols.years[i];
+    else if constexpr (F == CarField::Brand) return cols.brands[i];
+    else return cols.bodyTypes[i];
+}
+
+// Границы поля в блоке по зонной карте; для кодов словаря границ нет
+template <CarField F>
+inline pair<int, int> zoneBounds(const ZoneMap& zone) {
+    if constexpr (F == CarField::Price) return {zone.minPrice, zone.maxPrice};
+    else if constexpr (F == CarField::Mileage) return {zone.minMileage, zone.maxMileage};
+    else if constexpr (F == CarField::Year) return {zone.minYear, zone.maxYear};
+    else return {INT_MIN, INT_MAX};
+}
+
+// Условие должно уметь проверить строку и отбросить блок по зонной карте
+template <typename P>
+concept CarPredicate = requires(const P& p, const CarColumnsView& cols, size_t i, const ZoneMap& zone) {
+    { p.test(cols, i) } -> convertible_to<bool>;
+    { p.mayMatch(zone) } -> convertible_to<bool>;
+};
+
+// lo <= поле <= hi; открытые границы задаются INT_MIN / INT_MAX
+template <CarField F>
+struct Range {
+    int lo = INT_MIN;
+    int hi = INT_MAX;
+
+    bool test(const CarColumnsView& cols, size_t i) const {
+        int v = fieldValue<F>(cols, i);
+        return (v >= lo) & (v <= hi);
+    }
+    bool mayMatch(const ZoneMap& zone) const {
+        auto [zmin, zmax] = zoneBounds<F>(zone);
+        return zmax >= lo && zmin <= hi;
+    }
+};
+
+template <CarField F>
+struct Eq {
+    int value = 0;
+
+    bool test(const CarColumnsView& cols, size_t i) const { return fieldValue<F>(cols, i) == value; }
+    bool mayMatch(const ZoneMap& zone) const {
+        auto [zmin, zmax] = zoneBounds<F>(zone);
+        return zmin <= value && value <= zmax;
+    }
+};
+
+// Поле равно одному из N значений; N известно при компиляции, цикл разворачивается
+template <CarField F, size_t N>
+struct In {
+    array<int, N> values;
+
+    bool test(const CarColumnsView& cols, size_t i) const {
+        int v = fieldValue<F>(cols, i);
+        bool hit = false;
+        for (size_t k = 0; k < N; ++k) hit |= (v == values[k]);
+        return hit;
+    }
+    bool mayMatch(const ZoneMap& zone) const {
+        auto [zmin, zmax] = zoneBounds<F>(zone);
+        for (int value : values) {
+            if (zmin <= value && value <= zmax) return true;
+        }
+        return false;
+    }
+};
+
+template <CarPredicate A, CarPredicate B>
+struct And {
+    A a;
+    B b;
+
+    bool test(const CarColumnsView& cols, size_t i) const { return a.test(cols, i) & b.test(cols, i); }
+    bool mayMatch(const ZoneMap& zone) const { return a.mayMatch(zone) && b.mayMatch(zone); }
+};
+
+template <CarPredicate A, CarPredicate B>
+struct Or {
+    A a;
+    B b;
+
+    bool test(const CarColumnsView& cols, size_t i) const { return a.test(cols, i) | b.test(cols, i); }
+    bool mayMatch(const ZoneMap& zone) const { return a.mayMatch(zone) || b.mayMatch(zone); }
+};
+
+template <CarPredicate A>
+struct Not {
+    A a;
+
+    bool test(const CarColumnsView& cols, size_t i) const { return !a.test(cols, i); }
+    // Зонная карта не говорит, что условие выполнено для всех строк, поэтому блок не отбрасывается
+    bool mayMatch(const ZoneMap&) const { return true; }
+};
+
+// Сборка выражений: (Range<CarField::Price>{0, 20000} & oneOf<CarField::BodyType>(1, 2)) | !Eq<CarField::Year>{2010}
+template <CarPredicate A, CarPredicate B>
+And<A, B> operator&(const A& a, const B& b) { return {a, b}; }
+
+template <CarPredicate A, CarPredicate B>
+Or<A, B> operator|(const A& a, const B& b) { return {a, b}; }
+
+template <CarPredicate A>
+Not<A> operator!(const A& a) { return {a}; }
+
+template <CarField F, typename... V>
+In<F, sizeof...(V)> oneOf(V... values) { return {{static_cast<int>(values)...}}; }
+
+// Условие, эквивалентное CarCriteria без фильтра по кодам
+using CriteriaPredicate = And<And<Range<CarField::Price>, Range<CarField::Mileage>>, Range<CarField::Year>>;
+
+inline CriteriaPredicate criteriaPredicate(const CarCriteria& c) {
+    return Range<CarField::Price>{c.minPrice, c.maxPrice} & Range<CarField::Mileage>{INT_MIN, c.maxMileage} &
+           Range<CarField::Year>{c.minYear, INT_MAX};
+}
+
+// Маска выборки для строк [0, count): бит i слова i / 64 равен 1, если строка подходит.
+// Полные слова идут циклом с постоянной длиной 64, который компилятор разворачивает.
+template <CarPredicate P>
+void evaluatePredicate(const P& predicate, const CarColumnsView& cols, size_t count, uint64_t* mask) {
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; ++w) {
+        uint64_t bits = 0;
+        for (size_t k = 0; k < 64; ++k) {
+            bits |= static_cast<uint64_t>(predicate.test(cols, w * 64 + k)) << k;
+        }
+        mask[w] = bits;
+    }
+    
+    size_t base = fullWords * 64;
+    if (base < count) {
+        uint64_t bits = 0;
+        for (size_t k = 0; k < count - base; ++k) {
+            bits |= static_cast<uint64_t>(predicate.test(cols, base + k)) << k;
+        }
+        mask[fullWords] = bits;
+    }
+}
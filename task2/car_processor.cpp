@@ -1,60 +1,692 @@
 #include "car_processor.h"
-#include <thread>
 #include <algorithm>
 #include <iostream>
+#include <bit>
+#include <numeric>
+#include <climits>
+#include <stdexcept>
+#include <sstream>
+#include "filter_kernel.h"
 
 using namespace std;
 
-CarProcessor::CarProcessor(const vector<Car>& cars, int minP, int maxP, int maxM, int minY) : cars(cars), minPrice(minP), maxPrice(maxP), maxMileage(maxM), minYear(minY) {}
+// Если индекс отбирает больше этой доли строк, последовательный просмотр выгоднее
+// случайных обращений по номерам строк
+static constexpr double kIndexSelectivityLimit = 0.25;
 
-// Метод для обработки части массива
-void CarProcessor::processChunk(size_t start, size_t end, vector<Car>& result) {
-    vector<Car> localResult;
+CarProcessor::CarProcessor(shared_ptr<const CarDataset> data, ThreadPool& pool) : data(move(data)), pool(pool) {}
+
+void CarProcessor::storeScanStats(const ScanStats& stats) const {
+    lock_guard<mutex> lock(statsMutex);
+    lastScanStats = stats;
+}
+
+ScanStats CarProcessor::getLastScanStats() const {
+    lock_guard<mutex> lock(statsMutex);
+    return lastScanStats;
+}
+
+void CarProcessor::finishScan(const vector<ScanStats>& partStats, ScanClock::time_point queryStart, double mergeSeconds,
+                              size_t rowsMatched) const {
+    ScanStats stats;
+    for (const auto& part : partStats) {
+        stats.merge(part);
+    }
+    stats.rowsMatched = rowsMatched;
+    stats.mergeSeconds = mergeSeconds;
+    stats.totalSeconds = secondsSince(queryStart);
+    storeScanStats(stats);
+}
+
+double ScanStats::taskImbalance() const {
+    if (taskSeconds.empty()) return 1.0;
+    double sum = 0, slowest = 0;
+    for (double t : taskSeconds) {
+        sum += t;
+        slowest = max(slowest, t);
+    }
+    return sum > 0 ? slowest / (sum / taskSeconds.size()) : 1.0;
+}
+
+string ScanStats::toJson() const {
+    ostringstream out;
+    out << "{\"blocksTotal\":" << blocksTotal << ",\"blocksSkipped\":" << blocksSkipped
+        << ",\"blocksFullMatch\":" << blocksFullMatch << ",\"rowsScanned\":" << rowsScanned
+        << ",\"rowsMatched\":" << rowsMatched << ",\"bytesTouched\":" << bytesTouched
+        << ",\"morsels\":" << morsels << ",\"morselsStolen\":" << morselsStolen << ",\"taskSeconds\":[";
+    for (size_t i = 0; i < taskSeconds.size(); ++i) {
+        out << (i ? "," : "") << taskSeconds[i];
+    }
+    out << "],\"mergeSeconds\":" << mergeSeconds << ",\"totalSeconds\":" << totalSeconds
+        << ",\"rowsPerSecond\":" << rowsPerSecond() << ",\"gigabytesPerSecond\":" << gigabytesPerSecond()
+        << ",\"taskImbalance\":" << taskImbalance() << "}";
+    return out.str();
+}
+
+// Байт колонок на строку при колоночной проверке: три числовые колонки и коды из фильтра
+static size_t columnarRowBytes(const CarCriteria& criteria) {
+    return 3 * sizeof(int) + ((criteria.brandCode >= 0) + (criteria.bodyTypeCode >= 0)) * sizeof(StringCode);
+}
+
+void CarProcessor::buildBlockMask(size_t start, size_t end, const CarCriteria& criteria, uint64_t* mask) const {
+    size_t count = end - start;
+    filterColumns(data->getPrices() + start, data->getMileages() + start, data->getYears() + start, count, criteria, mask);
+    if (criteria.brandCode >= 0) {
+        filterCodes(data->getBrands() + start, count, static_cast<StringCode>(criteria.brandCode), mask);
+    }
+    if (criteria.bodyTypeCode >= 0) {
+        filterCodes(data->getBodyTypes() + start, count, static_cast<StringCode>(criteria.bodyTypeCode), mask);
+    }
+}
+
+void CarProcessor::scanColumnarBlock(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows) const {
+    uint64_t mask[kScanBlockRows / 64];
+    size_t count = end - start;
+    buildBlockMask(start, end, criteria, mask);
     
-    // Фильтрация автомобилей в заданном диапазоне
-    for (size_t i = start; i < end && i < cars.size(); ++i) {
-        if (cars[i].matchesCriteria(minPrice, maxPrice, maxMileage, minYear)) {
-            localResult.push_back(cars[i]);
+    // Обходим только установленные биты маски
+    for (size_t w = 0; w < (count + 63) / 64; ++w) {
+        uint64_t bits = mask[w];
+        while (bits) {
+            localRows.push_back(static_cast<RowId>(start + w * 64 + countr_zero(bits)));
+            bits &= bits - 1;
         }
     }
+}
+
+QueryPlan CarProcessor::planQuery(const CarCriteria& criteria) const {
+    QueryPlan plan;
+    plan.candidates = data->size();
+    if (!useIndexes || !data->hasIndexes()) return plan;
+    
+    // Точное число кандидатов по каждому индексу считается двумя бинарными поисками
+    QueryPlan options[] = {
+        {AccessPath::PriceIndex, data->getPriceIndex().countInRange(criteria.minPrice, criteria.maxPrice)},
+        {AccessPath::MileageIndex, data->getMileageIndex().countInRange(INT_MIN, criteria.maxMileage)},
+        {AccessPath::YearIndex, data->getYearIndex().countInRange(criteria.minYear, INT_MAX)}
+    };
+    for (const auto& option : options) {
+        if (option.candidates < plan.candidates) plan = option;
+    }
     
-    // Добавление результатов в общий список
-    lock_guard<mutex> lock(resultMutex);
-    result.insert(result.end(), localResult.begin(), localResult.end());
+    if (plan.candidates > data->size() * kIndexSelectivityLimit) {
+        plan.path = AccessPath::FullScan;
+        plan.candidates = data->size();
+    }
+    return plan;
+}
+
+CarSelection CarProcessor::selectByIndex(const CarCriteria& criteria, const QueryPlan& plan, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    const SortedColumnIndex* index = &data->getPriceIndex();
+    pair<size_t, size_t> range = index->range(criteria.minPrice, criteria.maxPrice);
+    if (plan.path == AccessPath::MileageIndex) {
+        index = &data->getMileageIndex();
+        range = index->range(INT_MIN, criteria.maxMileage);
+    } else if (plan.path == AccessPath::YearIndex) {
+        index = &data->getYearIndex();
+        range = index->range(criteria.minYear, INT_MAX);
+    }
+    
+    // Кандидаты делятся между задачами; остальные условия проверяются по колонкам
+    const int* prices = data->getPrices();
+    const int* mileages = data->getMileages();
+    const int* years = data->getYears();
+    const StringCode* brands = data->getBrands();
+    const StringCode* bodyTypes = data->getBodyTypes();
+    size_t numTasks = max(numThreads, 1);
+    size_t total = range.second - range.first;
+    size_t chunkSize = (total + numTasks - 1) / numTasks;
+    vector<vector<RowId>> parts(numTasks);
+    vector<ScanStats> partStats(numTasks);
+    
+    pool.parallelFor(numTasks, [&](size_t t) {
+        auto taskStart = ScanClock::now();
+        size_t start = range.first + min(t * chunkSize, total);
+        size_t end = range.first + min((t + 1) * chunkSize, total);
+        for (size_t pos = start; pos < end; ++pos) {
+            RowId row = index->rowAt(pos);
+            if (prices[row] >= criteria.minPrice && prices[row] <= criteria.maxPrice &&
+                mileages[row] <= criteria.maxMileage && years[row] >= criteria.minYear &&
+                (criteria.brandCode < 0 || brands[row] == criteria.brandCode) &&
+                (criteria.bodyTypeCode < 0 || bodyTypes[row] == criteria.bodyTypeCode)) {
+                parts[t].push_back(row);
+            }
+        }
+        // Номер строки из индекса и случайное чтение всех колонок кандидата
+        partStats[t].rowsScanned = end - start;
+        partStats[t].bytesTouched = (end - start) * (sizeof(RowId) + 3 * sizeof(int) + 2 * sizeof(StringCode));
+        partStats[t].taskSeconds.push_back(secondsSince(taskStart));
+    });
+    
+    auto mergeStart = ScanClock::now();
+    vector<RowId> rows;
+    for (const auto& part : parts) {
+        rows.insert(rows.end(), part.begin(), part.end());
+    }
+    
+    // Индекс упорядочен по значению поля; возвращаем строки в исходном порядке, как при просмотре
+    sort(rows.begin(), rows.end());
+    finishScan(partStats, queryStart, secondsSince(mergeStart), rows.size());
+    return CarSelection(data, move(rows));
+}
+
+// Проверка части одного блока: сначала зонная карта, затем построчно или по колонкам
+void CarProcessor::scanBlock(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows, ScanStats& stats) const {
+    const ZoneMap& zone = data->getZone(start / kScanBlockRows);
+    stats.blocksTotal++;
+    
+    if (!zone.mayMatch(criteria)) {
+        // Ни одна строка блока не может подойти
+        stats.blocksSkipped++;
+    } else if (zone.allMatch(criteria)) {
+        // Строки не читаются: достаточно зонной карты
+        stats.blocksFullMatch++;
+        stats.rowsScanned += end - start;
+        for (size_t i = start; i < end; ++i) {
+            localRows.push_back(static_cast<RowId>(i));
+        }
+    } else if (scanMode == ScanMode::Columnar || !data->hasRows()) {
+        // Для отображенного файла массива структур нет, используем колонки
+        stats.rowsScanned += end - start;
+        stats.bytesTouched += (end - start) * columnarRowBytes(criteria);
+        scanColumnarBlock(start, end, criteria, localRows);
+    } else {
+        stats.rowsScanned += end - start;
+        stats.bytesTouched += (end - start) * sizeof(Car);
+        const vector<Car>& cars = data->getCars();
+        for (size_t i = start; i < end; ++i) {
+            if (cars[i].matchesCriteria(criteria)) {
+                localRows.push_back(static_cast<RowId>(i));
+            }
+        }
+    }
+}
+
+// Метод для обработки части массива
+void CarProcessor::processChunk(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows, ScanStats& stats) const {
+    end = min(end, data->size());
+    
+    // Фильтрация автомобилей в заданном диапазоне поблочно
+    while (start < end) {
+        size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+        scanBlock(start, blockEnd, criteria, localRows, stats);
+        start = blockEnd;
+    }
+}
+
+size_t CarProcessor::alignedChunkSize(size_t numTasks) const {
+    size_t chunkSize = (data->size() / numTasks + kScanBlockRows - 1) / kScanBlockRows * kScanBlockRows;
+    return max(chunkSize, kScanBlockRows);
+}
+
+CarProcessor::ScanSplit CarProcessor::splitScan(size_t numTasks) const {
+    if (scheduling == ScanScheduling::Static) {
+        // Участок на задачу; остаток от выравнивания достается последней задаче
+        size_t chunkSize = alignedChunkSize(numTasks);
+        return {scheduling, chunkSize, min(numTasks, (data->size() + chunkSize - 1) / chunkSize)};
+    }
+    return {scheduling, morselRows, (data->size() + morselRows - 1) / morselRows};
+}
+
+// Склеивает буферы задач в один список, сохраняя порядок задач
+vector<RowId> CarProcessor::concatParts(const vector<vector<RowId>>& parts) const {
+    // Префиксная сумма по числу совпадений дает позицию каждого буфера в общем результате
+    vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = parts[i].size();
+    }
+    inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    
+    // Буферы копируются в свои непересекающиеся диапазоны параллельно,
+    // поэтому порядок совпадает с однопоточным просмотром
+    vector<RowId> rows(offsets.back());
+    pool.parallelFor(parts.size(), [&](size_t i) {
+        copy(parts[i].begin(), parts[i].end(), rows.begin() + offsets[i]);
+    });
+    return rows;
 }
 
 // Однопоточная обработка
-vector<Car> CarProcessor::processSingleThread() {
-    vector<Car> result;
-    processChunk(0, cars.size(), result);
-    return result;
+vector<Car> CarProcessor::processSingleThread(const CarCriteria& criteria) const {
+    return selectSingleThread(criteria).materialize();
 }
 
 // Многопоточная обработка
-vector<Car> CarProcessor::processMultiThread(int numThreads) {
-    vector<Car> result;
-    vector<thread> threads;
+vector<Car> CarProcessor::processMultiThread(const CarCriteria& criteria, int numThreads) const {
+    CarSelection selection = selectMultiThread(criteria, numThreads);
+    
+    // Копирование найденных автомобилей тоже делим между задачами пула
+    size_t numTasks = max(numThreads, 1);
+    size_t chunkSize = (selection.size() + numTasks - 1) / numTasks;
+    vector<Car> result(selection.size());
+    pool.parallelFor(numTasks, [&](size_t i) {
+        size_t start = min(i * chunkSize, selection.size());
+        size_t end = min(start + chunkSize, selection.size());
+        for (size_t j = start; j < end; ++j) {
+            result[j] = selection[j];
+        }
+    });
+    
+    return result;
+}
+
+CarSelection CarProcessor::selectSingleThread(const CarCriteria& criteria) const {
+    auto queryStart = ScanClock::now();
+    QueryPlan plan = planQuery(criteria);
+    if (plan.path != AccessPath::FullScan) {
+        return selectByIndex(criteria, plan, 1);
+    }
+    
+    vector<RowId> rows;
+    vector<ScanStats> partStats(1);
+    processChunk(0, data->size(), criteria, rows, partStats[0]);
+    partStats[0].taskSeconds.push_back(secondsSince(queryStart));
+    finishScan(partStats, queryStart, 0.0, rows.size());
+    return CarSelection(data, move(rows));
+}
+
+CarSelection CarProcessor::selectMultiThread(const CarCriteria& criteria, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    
+    QueryPlan plan = planQuery(criteria);
+    if (plan.path != AccessPath::FullScan) {
+        return selectByIndex(criteria, plan, numThreads);
+    }
+    
+    // Участки выровнены по границе блока зонных карт; у каждого участка свой буфер, мьютекс не нужен
+    ScanSplit split = splitScan(numThreads);
+    vector<vector<RowId>> parts(split.morselCount);
+    vector<ScanStats> partStats(numThreads);
+    
+    // Число одновременно работающих потоков ограничено размером пула
+    forEachMorsel(split, partStats, [&](size_t t, size_t m, size_t start, size_t end) {
+        processChunk(start, end, criteria, parts[m], partStats[t]);
+    });
+    
+    auto mergeStart = ScanClock::now();
+    vector<RowId> rows = concatParts(parts);
+    finishScan(partStats, queryStart, secondsSince(mergeStart), rows.size());
+    return CarSelection(data, move(rows));
+}
+
+QueryHandle CarProcessor::selectAsync(const CarCriteria& criteria, int numThreads, AsyncQueryOptions options) const {
+    if (numThreads < 1) numThreads = 1;
+    ScanSplit split = splitScan(numThreads);
+    if (split.mode == ScanScheduling::Static) {
+        split = {ScanScheduling::Morsel, morselRows, (data->size() + morselRows - 1) / morselRows};
+    }
     
-    // Рассчитываем размер чанка для каждого потока
-    size_t chunkSize = cars.size() / numThreads;
+    auto state = make_shared<AsyncQueryState>();
+    state->morselsTotal = split.morselCount;
     
-    // Создаем и запускаем потоки
-    for (int i = 0; i < numThreads; ++i) {
-        size_t start = i * chunkSize;
-        size_t end = (i == numThreads - 1) ? cars.size() : start + chunkSize;
+    // Пул принимает запрос и ждет его завершения в вызывающем потоке, поэтому раздачу участков
+    // ведет отдельный поток, а вызывающий сразу получает дескриптор.
+    // Дескриптор может пережить процессор, поэтому поток захватывает не this, а снимок, пул
+    // и настройки просмотра и работает через собственный процессор.
+    future<void> driver = async(launch::async, [data = data, &pool = pool, mode = scanMode, criteria, numThreads,
+                                                split, state, options = move(options)] {
+        CarProcessor scanner(data, pool);
+        scanner.setScanMode(mode);
         
-        if (start < cars.size()) {
-            // Запускаем поток для обработки диапазона
-            threads.emplace_back(&CarProcessor::processChunk, this, start, end, ref(result));
+        auto queryStart = ScanClock::now();
+        vector<vector<RowId>> parts(split.morselCount);
+        vector<ScanStats> partStats(numThreads);
+        mutex batchMutex;
+        
+        try {
+            scanner.forEachMorsel(split, partStats, [&](size_t t, size_t m, size_t start, size_t end) {
+                if (ScanClock::now() >= options.deadline) {
+                    state->deadlineExceeded = true;
+                    state->stopRequested = true;
+                    return;
+                }
+                
+                size_t firstRow = start;
+                while (start < end) {
+                    if (state->stopRequested.load(memory_order_relaxed)) {
+                        // Незавершенный участок в результат не попадает
+                        parts[m].clear();
+                        return;
+                    }
+                    size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+                    scanner.scanBlock(start, blockEnd, criteria, parts[m], partStats[t]);
+                    start = blockEnd;
+                }
+                
+                state->rowsMatched += parts[m].size();
+                if (options.onBatch) {
+                    try {
+                        lock_guard<mutex> lock(batchMutex);
+                        options.onBatch(QueryBatch{m, firstRow, end, parts[m]});
+                    } catch (...) {
+                        state->fail(current_exception());
+                    }
+                }
+                state->morselsDone++;
+            }, &state->stopRequested);
+        } catch (...) {
+            state->fail(current_exception());
+        }
+        
+        auto mergeStart = ScanClock::now();
+        vector<RowId> rows = scanner.concatParts(parts);
+        scanner.finishScan(partStats, queryStart, secondsSince(mergeStart), rows.size());
+        state->finish(CarSelection(data, move(rows)));
+    });
+    
+    return QueryHandle(state, move(driver));
+}
+
+vector<CarSelection> CarProcessor::selectBatch(const vector<CarCriteria>& batch, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    size_t numQueries = batch.size();
+    ScanSplit split = splitScan(numThreads);
+    
+    // parts[участок][запрос]: у каждой пары собственный буфер
+    vector<vector<vector<RowId>>> parts(split.morselCount, vector<vector<RowId>>(numQueries));
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(split, partStats, [&](size_t t, size_t m, size_t start, size_t end) {
+        // Внешний цикл по блокам, внутренний по запросам: блок остается в кэше,
+        // пока его проверяют все критерии пакета
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            for (size_t q = 0; q < numQueries; ++q) {
+                scanBlock(start, blockEnd, batch[q], parts[m][q], partStats[t]);
+            }
+            start = blockEnd;
         }
+    });
+    
+    // Сборка результата каждого запроса в порядке участков
+    auto mergeStart = ScanClock::now();
+    size_t rowsMatched = 0;
+    vector<CarSelection> results;
+    results.reserve(numQueries);
+    vector<vector<RowId>> queryParts(split.morselCount);
+    for (size_t q = 0; q < numQueries; ++q) {
+        for (size_t m = 0; m < split.morselCount; ++m) {
+            queryParts[m] = move(parts[m][q]);
+        }
+        results.emplace_back(data, concatParts(queryParts));
+        rowsMatched += results.back().size();
     }
+    finishScan(partStats, queryStart, secondsSince(mergeStart), rowsMatched);
+    return results;
+}
+
+// Агрегаты всегда считаются полным просмотром с зонными картами: строки не копируются,
+// поэтому выигрыш индекса здесь меньше, чем у выборки
+template <typename KeyOf>
+vector<CarAggregate> CarProcessor::aggregateGroups(const CarCriteria& criteria, int numThreads, size_t keyCount, KeyOf keyOf) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    const int* prices = data->getPrices();
+    const int* mileages = data->getMileages();
+    
+    // parts[задача][группа]: каждая задача копит собственные частичные агрегаты по всем своим участкам
+    vector<vector<CarAggregate>> parts(numThreads, vector<CarAggregate>(keyCount));
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(splitScan(numThreads), partStats, [&](size_t t, size_t, size_t start, size_t end) {
+        vector<CarAggregate>& local = parts[t];
+        ScanStats& stats = partStats[t];
+        uint64_t mask[kScanBlockRows / 64];
+        
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            const ZoneMap& zone = data->getZone(start / kScanBlockRows);
+            stats.blocksTotal++;
+            
+            if (!zone.mayMatch(criteria)) {
+                stats.blocksSkipped++;
+            } else if (zone.allMatch(criteria)) {
+                stats.blocksFullMatch++;
+                stats.rowsScanned += blockEnd - start;
+                stats.bytesTouched += (blockEnd - start) * 2 * sizeof(int);
+                for (size_t i = start; i < blockEnd; ++i) {
+                    local[keyOf(i)].add(prices[i], mileages[i]);
+                }
+            } else {
+                stats.rowsScanned += blockEnd - start;
+                stats.bytesTouched += (blockEnd - start) * columnarRowBytes(criteria);
+                buildBlockMask(start, blockEnd, criteria, mask);
+                for (size_t w = 0; w < (blockEnd - start + 63) / 64; ++w) {
+                    uint64_t bits = mask[w];
+                    while (bits) {
+                        size_t i = start + w * 64 + countr_zero(bits);
+                        local[keyOf(i)].add(prices[i], mileages[i]);
+                        bits &= bits - 1;
+                    }
+                }
+            }
+            start = blockEnd;
+        }
+    });
     
-    // Ожидаем завершения всех потоков
-    for (auto& thread : threads) {
-        if (thread.joinable()) {
-            thread.join();
+    // Слияние частичных агрегатов: O(задачи * группы), независимо от числа строк
+    auto mergeStart = ScanClock::now();
+    vector<CarAggregate> total(keyCount);
+    size_t rowsMatched = 0;
+    for (const auto& part : parts) {
+        for (size_t k = 0; k < keyCount; ++k) {
+            total[k].merge(part[k]);
+            rowsMatched += part[k].count;
         }
     }
+    finishScan(partStats, queryStart, secondsSince(mergeStart), rowsMatched);
+    return total;
+}
+
+CarAggregate CarProcessor::aggregate(const CarCriteria& criteria, int numThreads) const {
+    return aggregateGroups(criteria, numThreads, 1, [](size_t) { return 0; })[0];
+}
+
+vector<CarGroup> CarProcessor::aggregateBy(const CarCriteria& criteria, GroupBy groupBy, int numThreads) const {
+    // Ключи группировки плотные, поэтому группы хранятся в массиве, а не в хеш-таблице
+    vector<CarAggregate> groups;
+    int keyBase = 0;
+    if (groupBy == GroupBy::Brand) {
+        const StringCode* brands = data->getBrands();
+        groups = aggregateGroups(criteria, numThreads, brandDictionary().size(), [brands](size_t i) { return brands[i]; });
+    } else if (groupBy == GroupBy::BodyType) {
+        const StringCode* bodyTypes = data->getBodyTypes();
+        groups = aggregateGroups(criteria, numThreads, bodyTypeDictionary().size(), [bodyTypes](size_t i) { return bodyTypes[i]; });
+    } else {
+        // Годы лежат в диапазоне из общей зонной карты снимка
+        const int* years = data->getYears();
+        const ZoneMap& totals = data->getTotals();
+        keyBase = totals.minYear;
+        size_t keyCount = data->size() ? static_cast<size_t>(totals.maxYear - totals.minYear) + 1 : 0;
+        groups = aggregateGroups(criteria, numThreads, keyCount, [years, keyBase](size_t i) { return years[i] - keyBase; });
+    }
     
+    vector<CarGroup> result;
+    for (size_t k = 0; k < groups.size(); ++k) {
+        if (groups[k].count > 0) {
+            result.push_back({static_cast<int>(k) + keyBase, groups[k]});
+        }
+    }
     return result;
-}
\ No newline at end of file
+}
+
+// Ключ сортировки: меньший ключ идет раньше, поэтому для убывания значение берется с минусом
+static inline long long sortKey(int value, bool descending) {
+    return descending ? -static_cast<long long>(value) : value;
+}
+
+// Лучший (наименьший) ключ, который может встретиться в блоке
+static long long bestKeyInZone(const ZoneMap& zone, SortOrder order) {
+    switch (order.field) {
+        case SortField::Mileage: return order.descending ? sortKey(zone.maxMileage, true) : zone.minMileage;
+        case SortField::Year: return order.descending ? sortKey(zone.maxYear, true) : zone.minYear;
+        default: return order.descending ? sortKey(zone.maxPrice, true) : zone.minPrice;
+    }
+}
+
+CarSelection CarProcessor::selectTopK(const CarCriteria& criteria, SortOrder order, size_t limit, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    if (limit == 0) return CarSelection(data, {});
+    
+    const int* values = order.field == SortField::Mileage ? data->getMileages()
+                      : order.field == SortField::Year ? data->getYears() : data->getPrices();
+    
+    // Пара (ключ, строка); сравнение пар дает нужный порядок вместе с правилом для равных ключей
+    using Entry = pair<long long, RowId>;
+    vector<vector<Entry>> heaps(numThreads);
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(splitScan(numThreads), partStats, [&](size_t t, size_t, size_t start, size_t end) {
+        vector<Entry>& heap = heaps[t];   // На вершине худший из отобранных; общая для всех участков задачи
+        ScanStats& stats = partStats[t];
+        // Куча растет не больше чем на число строк участка: limit может быть любым, вплоть до SIZE_MAX
+        heap.reserve(min(limit, heap.size() + (end - start)));
+        uint64_t mask[kScanBlockRows / 64];
+        
+        auto offer = [&](size_t i) {
+            stats.rowsMatched++;
+            Entry entry(sortKey(values[i], order.descending), static_cast<RowId>(i));
+            if (heap.size() < limit) {
+                heap.push_back(entry);
+                push_heap(heap.begin(), heap.end());
+            } else if (entry < heap.front()) {
+                pop_heap(heap.begin(), heap.end());
+                heap.back() = entry;
+                push_heap(heap.begin(), heap.end());
+            }
+        };
+        
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            const ZoneMap& zone = data->getZone(start / kScanBlockRows);
+            stats.blocksTotal++;
+            
+            // Любая строка блока не лучше пары (лучший ключ зоны, первая строка блока); если и эта пара
+            // не лучше худшей в заполненной куче, блок ничего не изменит. Сравнение учитывает номер строки,
+            // потому что участки могут достаться задаче не по порядку
+            if (!zone.mayMatch(criteria) ||
+                (heap.size() == limit && Entry(bestKeyInZone(zone, order), static_cast<RowId>(start)) >= heap.front())) {
+                stats.blocksSkipped++;
+            } else if (zone.allMatch(criteria)) {
+                stats.blocksFullMatch++;
+                stats.rowsScanned += blockEnd - start;
+                stats.bytesTouched += (blockEnd - start) * sizeof(int);
+                for (size_t i = start; i < blockEnd; ++i) {
+                    offer(i);
+                }
+            } else {
+                stats.rowsScanned += blockEnd - start;
+                stats.bytesTouched += (blockEnd - start) * columnarRowBytes(criteria);
+                buildBlockMask(start, blockEnd, criteria, mask);
+                for (size_t w = 0; w < (blockEnd - start + 63) / 64; ++w) {
+                    uint64_t bits = mask[w];
+                    while (bits) {
+                        offer(start + w * 64 + countr_zero(bits));
+                        bits &= bits - 1;
+                    }
+                }
+            }
+            start = blockEnd;
+        }
+    });
+    
+    // Слияние: не больше numThreads * limit кандидатов, из них сортируются только первые limit
+    auto mergeStart = ScanClock::now();
+    vector<Entry> candidates;
+    for (const auto& heap : heaps) {
+        candidates.insert(candidates.end(), heap.begin(), heap.end());
+    }
+    size_t count = min(limit, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    
+    vector<RowId> rows(count);
+    for (size_t i = 0; i < count; ++i) {
+        rows[i] = candidates[i].second;
+    }
+    
+    // Подходящие строки, прошедшие через кучи; блоки, отсеянные кучей, не считаются
+    size_t offered = 0;
+    for (const auto& part : partStats) {
+        offered += part.rowsMatched;
+    }
+    finishScan(partStats, queryStart, secondsSince(mergeStart), offered);
+    return CarSelection(data, move(rows));
+}
+
+SelectionBitmap CarProcessor::selectBitmap(const CarCriteria& criteria, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    SelectionBitmap bitmap(data->size());
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(splitScan(numThreads), partStats, [&](size_t t, size_t, size_t start, size_t end) {
+        ScanStats& stats = partStats[t];
+        
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            const ZoneMap& zone = data->getZone(start / kScanBlockRows);
+            stats.blocksTotal++;
+            
+            if (!zone.mayMatch(criteria)) {
+                // Слова блока остаются нулевыми
+                stats.blocksSkipped++;
+            } else if (zone.allMatch(criteria)) {
+                stats.blocksFullMatch++;
+                stats.rowsScanned += blockEnd - start;
+                bitmap.setRange(start, blockEnd);
+            } else {
+                stats.rowsScanned += blockEnd - start;
+                stats.bytesTouched += (blockEnd - start) * columnarRowBytes(criteria);
+                buildBlockMask(start, blockEnd, criteria, bitmap.data() + start / 64);
+            }
+            start = blockEnd;
+        }
+    });
+    
+    finishScan(partStats, queryStart, 0.0, bitmap.count());
+    return bitmap;
+}
+
+CarSelection CarProcessor::selectFromBitmap(const SelectionBitmap& bitmap, int numThreads) const {
+    if (bitmap.size() != data->size()) {
+        throw invalid_argument("selectFromBitmap: карта построена для другого снимка");
+    }
+    if (numThreads < 1) numThreads = 1;
+    size_t numTasks = numThreads;
+    size_t numWords = bitmap.wordCount();
+    size_t wordsPerTask = (numWords + numTasks - 1) / numTasks;
+    const uint64_t* words = bitmap.data();
+    
+    // Первый проход: popcount по словам каждой задачи дает смещения ее строк в результате
+    vector<size_t> offsets(numTasks + 1, 0);
+    pool.parallelFor(numTasks, [&](size_t t) {
+        size_t first = min(t * wordsPerTask, numWords);
+        size_t last = min(first + wordsPerTask, numWords);
+        size_t count = 0;
+        for (size_t w = first; w < last; ++w) {
+            count += popcount(words[w]);
+        }
+        offsets[t + 1] = count;
+    });
+    inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    
+    // Второй проход: каждая задача пишет номера строк в свой диапазон
+    vector<RowId> rows(offsets.back());
+    pool.parallelFor(numTasks, [&](size_t t) {
+        size_t first = min(t * wordsPerTask, numWords);
+        size_t last = min(first + wordsPerTask, numWords);
+        size_t pos = offsets[t];
+        for (size_t w = first; w < last; ++w) {
+            uint64_t bits = words[w];
+            while (bits) {
+                rows[pos++] = static_cast<RowId>(w * 64 + countr_zero(bits));
+                bits &= bits - 1;
+            }
+        }
+    });
+    return CarSelection(data, move(rows));
+}
@@ -1,28 +1,358 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <chrono>
+#include <bit>
+#include <algorithm>
 #include "car.h"
+#include "car_aggregate.h"
+#include "car_dataset.h"
+#include "car_predicate.h"
+#include "car_selection.h"
+#include "morsel_queue.h"
+#include "query_handle.h"
+#include "selection_bitmap.h"
+#include "thread_pool.h"
 
 using namespace std;
+
+// Способ просмотра данных при фильтрации
+enum class ScanMode {
+    RowWise,     // Проверка Car::matchesCriteria для каждой структуры
+    Columnar     // Колоночные массивы и SIMD-ядро
+};
+
+// Распределение полного просмотра между задачами пула
+enum class ScanScheduling {
+    Static,      // Один непрерывный участок на задачу: самая медленная задача задает время запроса
+    Morsel,      // Мелкие участки (морсели) из общей очереди: освободившаяся задача берет следующий
+    Affinity     // У каждого рабочего потока свой диапазон морселей, закончивший поток крадет чужие
+};
+
+// Способ доступа к данным, выбранный планировщиком запроса
+enum class AccessPath {
+    FullScan,
+    PriceIndex,
+    MileageIndex,
+    YearIndex
+};
+
+using ScanClock = chrono::steady_clock;
+
+inline double secondsSince(ScanClock::time_point start) {
+    return chrono::duration<double>(ScanClock::now() - start).count();
+}
+
+// Статистика последнего запроса: блоки, строки, байты и время по задачам.
+// По ней видно, упирается ли запрос в память (гигабайты в секунду), в самую медленную задачу
+// (taskImbalance) или в склейку результатов (mergeSeconds).
+struct ScanStats {
+    size_t blocksTotal = 0;      // Просмотрено блоков
+    size_t blocksSkipped = 0;    // Пропущено по зонным картам
+    size_t blocksFullMatch = 0;  // Подошли целиком без построчной проверки
+    size_t rowsScanned = 0;      // Строк в непропущенных блоках (для индекса - кандидатов)
+    size_t rowsMatched = 0;      // Подошло строк (для пакета - сумма по запросам)
+    size_t bytesTouched = 0;     // Прочитано байт данных строк; зонные карты не учитываются
+    size_t morsels = 0;          // Участков просмотра, выданных задачам
+    size_t morselsStolen = 0;    // Из них взято из чужого диапазона (режим Affinity)
+    vector<double> taskSeconds;  // Время каждой задачи пула в порядке задач
+    double mergeSeconds = 0;     // Склейка и слияние результатов задач
+    double totalSeconds = 0;     // Весь запрос
+    
+    // Сложение статистики задач; время задач дописывается в список
+    void merge(const ScanStats& other) {
+        blocksTotal += other.blocksTotal;
+        blocksSkipped += other.blocksSkipped;
+        blocksFullMatch += other.blocksFullMatch;
+        rowsScanned += other.rowsScanned;
+        rowsMatched += other.rowsMatched;
+        bytesTouched += other.bytesTouched;
+        morsels += other.morsels;
+        morselsStolen += other.morselsStolen;
+        taskSeconds.insert(taskSeconds.end(), other.taskSeconds.begin(), other.taskSeconds.end());
+    }
+    
+    double rowsPerSecond() const { return totalSeconds > 0 ? rowsScanned / totalSeconds : 0.0; }
+    double gigabytesPerSecond() const { return totalSeconds > 0 ? bytesTouched / totalSeconds / 1e9 : 0.0; }
+    
+    // Самая долгая задача относительно средней: 1 - задачи закончили одновременно
+    double taskImbalance() const;
+    
+    string toJson() const;
+};
+
+// Поле сортировки для запросов ORDER BY + LIMIT
+enum class SortField {
+    Price,
+    Mileage,
+    Year
+};
+
+struct SortOrder {
+    SortField field = SortField::Price;
+    bool descending = false;
+};
+
+struct QueryPlan {
+    AccessPath path = AccessPath::FullScan;
+    size_t candidates = 0;       // Сколько строк придется проверить
+};
+
+// Исполнитель запросов над общим снимком данных.
+// Создание стоит O(1): данные не копируются, критерии передаются в каждый запрос.
 class CarProcessor {
 private:
-    vector<Car> cars;        // Исходный список автомобилей
-    int minPrice;                 // Минимальная цена
-    int maxPrice;                 // Максимальная цена
-    int maxMileage;               // Максимальный пробег
-    int minYear;                  // Минимальный год выпуска
+    shared_ptr<const CarDataset> data;   // Общий неизменяемый снимок
+    ThreadPool& pool;                    // Рабочие потоки, общие для всех процессоров
     
-    mutex resultMutex;       // Мьютекс для синхронизации доступа к результатам
+    ScanMode scanMode = ScanMode::RowWise;
+    bool useIndexes = true;
+    ScanScheduling scheduling = ScanScheduling::Morsel;
+    size_t morselRows = kDefaultMorselRows;
     
-    // Метод для обработки части массива автомобилей
-    void processChunk(size_t start, size_t end, vector<Car>& result);
+    mutable mutex statsMutex;
+    mutable ScanStats lastScanStats;
+    
+    // Метод для обработки части массива автомобилей; номера подходящих строк пишутся в собственный буфер вызывающего
+    void processChunk(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows, ScanStats& stats) const;
+    
+    // Маска выборки части одного блока по колонкам; mask вмещает kScanBlockRows / 64 слов
+    void buildBlockMask(size_t start, size_t end, const CarCriteria& criteria, uint64_t* mask) const;
+    
+    // Фильтрация части одного блока по колонкам с помощью маски выборки
+    void scanColumnarBlock(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows) const;
+    
+    // Проверка части одного блока с учетом его зонной карты
+    void scanBlock(size_t start, size_t end, const CarCriteria& criteria, vector<RowId>& localRows, ScanStats& stats) const;
+    
+    size_t alignedChunkSize(size_t numTasks) const;
+    
+    // Разбиение снимка на участки для numTasks задач; последний участок доходит до конца снимка
+    struct ScanSplit {
+        ScanScheduling mode = ScanScheduling::Morsel;
+        size_t morselRows = 0;
+        size_t morselCount = 0;
+    };
+    ScanSplit splitScan(size_t numTasks) const;
+    
+    // Вызывает fn(задача, участок, start, end) для каждого участка по правилам split.mode.
+    // Число задач равно partStats.size(); время задач и число участков пишутся в partStats.
+    // Номер участка растет вместе с номерами строк, поэтому буферы по участкам склеиваются в порядке строк.
+    // Когда *stop становится true, новые участки больше не выдаются.
+    template <typename Fn>
+    void forEachMorsel(const ScanSplit& split, vector<ScanStats>& partStats, Fn&& fn,
+                       const atomic<bool>* stop = nullptr) const;
+    vector<RowId> concatParts(const vector<vector<RowId>>& parts) const;
+    
+    void storeScanStats(const ScanStats& stats) const;
+    
+    // Сводит статистику задач, дописывает время слияния и всего запроса и сохраняет как последнюю
+    void finishScan(const vector<ScanStats>& partStats, ScanClock::time_point queryStart, double mergeSeconds,
+                    size_t rowsMatched) const;
+    
+    // Выборка через индекс: проверяются только строки-кандидаты из плана
+    CarSelection selectByIndex(const CarCriteria& criteria, const QueryPlan& plan, int numThreads) const;
+    
+    // Частичные агрегаты по группам [0, keyCount): каждая задача копит свои, в конце они складываются
+    template <typename KeyOf>
+    vector<CarAggregate> aggregateGroups(const CarCriteria& criteria, int numThreads, size_t keyCount, KeyOf keyOf) const;
     
 public:
-    CarProcessor(const vector<Car>& cars, int minP, int maxP, int maxM, int minY);
+    explicit CarProcessor(shared_ptr<const CarDataset> data, ThreadPool& pool = ThreadPool::shared());
+    
+    void setScanMode(ScanMode mode) { scanMode = mode; }
+    ScanMode getScanMode() const { return scanMode; }
+    
+    void setScheduling(ScanScheduling mode) { scheduling = mode; }
+    ScanScheduling getScheduling() const { return scheduling; }
+    
+    // Размер морселя в строках, округляется вверх до целого числа блоков
+    void setMorselRows(size_t rows) { morselRows = max<size_t>(1, (rows + kScanBlockRows - 1) / kScanBlockRows) * kScanBlockRows; }
+    size_t getMorselRows() const { return morselRows; }
+    
+    // Разрешает планировщику использовать индексы снимка (если они построены)
+    void setUseIndexes(bool use) { useIndexes = use; }
+    
+    const shared_ptr<const CarDataset>& getDataset() const { return data; }
+    
+    // Выбирает самый селективный индекс или полный просмотр
+    QueryPlan planQuery(const CarCriteria& criteria) const;
+    
+    // Сколько блоков просмотрел и пропустил последний запрос
+    ScanStats getLastScanStats() const;
+    
+    // Размер блока зонных карт и колоночного просмотра
+    static constexpr size_t kScanBlockRows = CarDataset::kBlockRows;
+    
+    // 16K строк: колонки морселя (около 256 КБ) помещаются в кэш L2 одного ядра
+    static constexpr size_t kDefaultMorselRows = 4 * kScanBlockRows;
     
     // Однопоточная обработка
-    vector<Car> processSingleThread();
+    vector<Car> processSingleThread(const CarCriteria& criteria) const;
     
     // Многопоточная обработка
-    vector<Car> processMultiThread(int numThreads);
-};
\ No newline at end of file
+    vector<Car> processMultiThread(const CarCriteria& criteria, int numThreads) const;
+    
+    // Запросы без копирования: возвращают номера подходящих строк
+    CarSelection selectSingleThread(const CarCriteria& criteria) const;
+    CarSelection selectMultiThread(const CarCriteria& criteria, int numThreads) const;
+    
+    // Пакет запросов за один проход по данным: каждый блок загружается в кэш один раз
+    // и проверяется сразу по всем критериям пакета. Результаты идут в порядке batch.
+    vector<CarSelection> selectBatch(const vector<CarCriteria>& batch, int numThreads) const;
+    
+    // Первые limit подходящих строк в порядке order; при равных значениях раньше идет меньший номер строки.
+    // Каждая задача держит ограниченную кучу из limit элементов, полная сортировка не нужна.
+    CarSelection selectTopK(const CarCriteria& criteria, SortOrder order, size_t limit, int numThreads) const;
+    
+    // Выборка по составному условию (car_predicate.h); порядок строк как у selectMultiThread.
+    // Тело проверки строится компилятором под конкретный тип условия.
+    template <CarPredicate P>
+    CarSelection selectWhere(const P& predicate, int numThreads) const;
+    
+    // Выборка в виде битовой карты на весь снимок. Блоки выровнены по 64 строкам,
+    // поэтому задачи пишут маски прямо в свои слова карты, без промежуточных буферов и склейки.
+    SelectionBitmap selectBitmap(const CarCriteria& criteria, int numThreads) const;
+    
+    template <CarPredicate P>
+    SelectionBitmap selectBitmapWhere(const P& predicate, int numThreads) const;
+    
+    // Номера строк из карты (например, после комбинации нескольких карт) параллельно по словам
+    CarSelection selectFromBitmap(const SelectionBitmap& bitmap, int numThreads) const;
+    
+    // Асинхронная выборка полным просмотром. Возвращается сразу; просмотр идет в пуле по морселям
+    // (даже при ScanScheduling::Static), и по их границам проверяются отмена и срок.
+    // Каждый завершенный морсель сразу передается в options.onBatch, так что первые строки видны
+    // до конца просмотра. Индексы не используются: порции соответствуют участкам таблицы.
+    // Запрос держит снимок и настройки на момент вызова, поэтому процессор можно удалить раньше
+    // дескриптора, а пул - нет. Статистика запроса в getLastScanStats() не попадает.
+    QueryHandle selectAsync(const CarCriteria& criteria, int numThreads, AsyncQueryOptions options = {}) const;
+    
+    // Агрегаты подходящих строк без их копирования (count, сумма, среднее, min, max цены и пробега)
+    CarAggregate aggregate(const CarCriteria& criteria, int numThreads) const;
+    
+    // Агрегаты с группировкой; возвращаются только непустые группы, по возрастанию ключа
+    vector<CarGroup> aggregateBy(const CarCriteria& criteria, GroupBy groupBy, int numThreads) const;
+    
+    int getPoolSize() const { return pool.getThreadCount(); }
+    
+    // Задержка передачи последнего многопоточного запроса в пул, мкс
+    double getLastDispatchLatencyUs() const { return pool.getLastDispatchLatencyUs(); }
+};
+
+template <typename Fn>
+void CarProcessor::forEachMorsel(const ScanSplit& split, vector<ScanStats>& partStats, Fn&& fn,
+                                 const atomic<bool>* stop) const {
+    size_t numTasks = partStats.size();
+    auto morselStart = [&](size_t m) { return m * split.morselRows; };
+    auto morselEnd = [&](size_t m) { return m + 1 == split.morselCount ? data->size() : (m + 1) * split.morselRows; };
+    
+    if (split.mode == ScanScheduling::Static) {
+        pool.parallelFor(numTasks, [&](size_t t) {
+            auto taskStart = ScanClock::now();
+            if (t < split.morselCount) {
+                partStats[t].morsels++;
+                fn(t, t, morselStart(t), morselEnd(t));
+            }
+            partStats[t].taskSeconds.push_back(secondsSince(taskStart));
+        });
+        return;
+    }
+    
+    // В режиме Affinity домашний диапазон выбирается по номеру рабочего потока, а не задачи:
+    // при закрепленных потоках одни и те же строки от запроса к запросу читает одно и то же ядро
+    bool affinity = split.mode == ScanScheduling::Affinity;
+    MorselQueue queue(split.morselCount, affinity ? numTasks : 1);
+    pool.parallelFor(numTasks, [&](size_t t) {
+        auto taskStart = ScanClock::now();
+        int worker = ThreadPool::currentWorkerIndex();
+        size_t home = affinity && worker >= 0 ? static_cast<size_t>(worker) : t;
+        size_t m;
+        bool stolen;
+        while (!(stop && stop->load(memory_order_relaxed)) && queue.pop(home, m, stolen)) {
+            partStats[t].morsels++;
+            partStats[t].morselsStolen += stolen;
+            fn(t, m, morselStart(m), morselEnd(m));
+        }
+        partStats[t].taskSeconds.push_back(secondsSince(taskStart));
+    });
+}
+
+template <CarPredicate P>
+CarSelection CarProcessor::selectWhere(const P& predicate, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    ScanSplit split = splitScan(numThreads);
+    CarColumnsView cols{data->getPrices(), data->getMileages(), data->getYears(), data->getBrands(), data->getBodyTypes()};
+    
+    vector<vector<RowId>> parts(split.morselCount);
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(split, partStats, [&](size_t t, size_t m, size_t start, size_t end) {
+        uint64_t mask[kScanBlockRows / 64];
+        
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            partStats[t].blocksTotal++;
+            
+            if (!predicate.mayMatch(data->getZone(start / kScanBlockRows))) {
+                partStats[t].blocksSkipped++;
+            } else {
+                // Для условий учитываются все пять колонок: это верхняя оценка прочитанного
+                partStats[t].rowsScanned += blockEnd - start;
+                partStats[t].bytesTouched += (blockEnd - start) * (3 * sizeof(int) + 2 * sizeof(StringCode));
+                CarColumnsView blockCols{cols.prices + start, cols.mileages + start, cols.years + start,
+                                         cols.brands + start, cols.bodyTypes + start};
+                evaluatePredicate(predicate, blockCols, blockEnd - start, mask);
+                for (size_t w = 0; w < (blockEnd - start + 63) / 64; ++w) {
+                    uint64_t bits = mask[w];
+                    while (bits) {
+                        parts[m].push_back(static_cast<RowId>(start + w * 64 + countr_zero(bits)));
+                        bits &= bits - 1;
+                    }
+                }
+            }
+            start = blockEnd;
+        }
+    });
+    
+    auto mergeStart = ScanClock::now();
+    vector<RowId> rows = concatParts(parts);
+    double mergeSeconds = secondsSince(mergeStart);
+    finishScan(partStats, queryStart, mergeSeconds, rows.size());
+    return CarSelection(data, move(rows));
+}
+
+template <CarPredicate P>
+SelectionBitmap CarProcessor::selectBitmapWhere(const P& predicate, int numThreads) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    ScanSplit split = splitScan(numThreads);
+    CarColumnsView cols{data->getPrices(), data->getMileages(), data->getYears(), data->getBrands(), data->getBodyTypes()};
+    SelectionBitmap bitmap(data->size());
+    vector<ScanStats> partStats(numThreads);
+    
+    forEachMorsel(split, partStats, [&](size_t t, size_t, size_t start, size_t end) {
+        while (start < end) {
+            size_t blockEnd = min((start / kScanBlockRows + 1) * kScanBlockRows, end);
+            partStats[t].blocksTotal++;
+            
+            if (!predicate.mayMatch(data->getZone(start / kScanBlockRows))) {
+                partStats[t].blocksSkipped++;
+            } else {
+                // Для условий учитываются все пять колонок: это верхняя оценка прочитанного
+                partStats[t].rowsScanned += blockEnd - start;
+                partStats[t].bytesTouched += (blockEnd - start) * (3 * sizeof(int) + 2 * sizeof(StringCode));
+                CarColumnsView blockCols{cols.prices + start, cols.mileages + start, cols.years + start,
+                                         cols.brands + start, cols.bodyTypes + start};
+                evaluatePredicate(predicate, blockCols, blockEnd - start, bitmap.data() + start / 64);
+            }
+            start = blockEnd;
+        }
+    });
+    
+    finishScan(partStats, queryStart, 0.0, bitmap.count());
+    return bitmap;
+}
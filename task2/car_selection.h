@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include "car.h"
+#include "car_dataset.h"
+
+using namespace std;
+
+// Результат запроса без копирования: номера подходящих строк и ссылка на снимок данных.
+// Держит снимок живым, поэтому может пережить процессор, который его вернул.
+class CarSelection {
+private:
+    shared_ptr<const CarDataset> data;
+    vector<RowId> rows;
+    
+public:
+    CarSelection() = default;
+    CarSelection(shared_ptr<const CarDataset> data, vector<RowId> rows) : data(move(data)), rows(move(rows)) {}
+    
+    size_t size() const { return rows.size(); }
+    bool empty() const { return rows.empty(); }
+    
+    // Номера строк в порядке исходного массива (для selectTopK - в порядке сортировки)
+    const vector<RowId>& getRows() const { return rows; }
+    RowId rowAt(size_t i) const { return rows[i]; }
+    
+    // Доступ к автомобилю без копирования всего результата
+    Car operator[](size_t i) const { return (*data)[rows[i]]; }
+    
+    // Копирование в vector<Car> только по запросу вызывающего (например, для одной страницы)
+    vector<Car> materialize(size_t offset = 0, size_t count = SIZE_MAX) const {
+        vector<Car> result;
+        if (offset >= rows.size()) return result;
+        size_t end = offset + min(count, rows.size() - offset);
+        result.reserve(end - offset);
+        for (size_t i = offset; i < end; ++i) {
+            result.push_back((*data)[rows[i]]);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,203 @@
+#include "car_stream.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "filter_kernel.h"
+
+using namespace std;
+
+CarFileReader::CarFileReader(const string& path) : path(path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть " + path + ": " + strerror(errno));
+    }
+    
+    try {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw runtime_error("Не удалось получить размер " + path + ": " + strerror(errno));
+        }
+        uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+        if (fileSize < sizeof(header)) {
+            throw runtime_error(path + ": файл слишком мал для заголовка");
+        }
+        readAt(0, &header, sizeof(header));
+        validateCarFileHeader(header, fileSize, path);
+        
+        zones.resize(header.blockCount);
+        readAt(header.zoneOffset, zones.data(), zones.size() * sizeof(ZoneMap));
+        
+        // Словари лежат в конце файла подряд и занимают мало места, читаются целиком.
+        // Порядок смещений уже проверен validateCarFileHeader, поэтому разности не переполняются
+        vector<char> dictionaries(header.fileSize - header.brandDictOffset);
+        readAt(header.brandDictOffset, dictionaries.data(), dictionaries.size());
+        loadCarFileDictionary(dictionaries.data(), dictionaries.size(), 0, header.brandDictCount,
+                              brandDictionary(), brandRemap);
+        loadCarFileDictionary(dictionaries.data(), dictionaries.size(), header.bodyTypeDictOffset - header.brandDictOffset,
+                              header.bodyTypeDictCount, bodyTypeDictionary(), bodyTypeRemap);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+CarFileReader::~CarFileReader() {
+    close(fd);
+}
+
+void CarFileReader::readAt(uint64_t offset, void* buffer, size_t bytes) const {
+    char* out = static_cast<char*>(buffer);
+    while (bytes > 0) {
+        ssize_t n = pread(fd, out, bytes, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw runtime_error("Ошибка чтения " + path + ": " + (n < 0 ? strerror(errno) : "неожиданный конец файла"));
+        }
+        out += n;
+        offset += n;
+        bytes -= n;
+    }
+}
+
+size_t CarFileReader::readRows(size_t start, size_t count, CarColumns& out) const {
+    out.resize(count);
+    readAt(header.priceOffset + start * sizeof(int), out.prices.data(), count * sizeof(int));
+    readAt(header.mileageOffset + start * sizeof(int), out.mileages.data(), count * sizeof(int));
+    readAt(header.yearOffset + start * sizeof(int), out.years.data(), count * sizeof(int));
+    readAt(header.brandOffset + start * sizeof(StringCode), out.brands.data(), count * sizeof(StringCode));
+    readAt(header.bodyTypeOffset + start * sizeof(StringCode), out.bodyTypes.data(), count * sizeof(StringCode));
+    
+    // Код вне словаря файла - признак повреждения, как и в CarDataset::mapFile
+    bool valid = all_of(out.brands.begin(), out.brands.end(), [&](StringCode c) { return c < brandRemap.size(); }) &&
+                 all_of(out.bodyTypes.begin(), out.bodyTypes.end(), [&](StringCode c) { return c < bodyTypeRemap.size(); });
+    if (!valid) {
+        throw runtime_error(path + ": код марки или кузова вне словаря файла");
+    }
+    for (StringCode& code : out.brands) {
+        code = brandRemap[code];
+    }
+    for (StringCode& code : out.bodyTypes) {
+        code = bodyTypeRemap[code];
+    }
+    return count * (3 * sizeof(int) + 2 * sizeof(StringCode));
+}
+
+// Фильтрация одной порции в пуле: задачи берут блоки порции, результаты склеиваются по порядку блоков
+static void filterChunk(const CarFileReader& reader, const CarColumns& chunk, size_t firstRow,
+                        const CarCriteria& criteria, ThreadPool& pool, StreamBatch& batch) {
+    const size_t blockRows = CarDataset::kBlockRows;
+    size_t numBlocks = (chunk.size() + blockRows - 1) / blockRows;
+    vector<vector<RowId>> parts(numBlocks);
+    
+    pool.parallelFor(numBlocks, [&](size_t b) {
+        size_t start = b * blockRows;
+        size_t count = min(blockRows, chunk.size() - start);
+        if (!reader.getZone((firstRow + start) / blockRows).mayMatch(criteria)) return;
+        
+        uint64_t mask[CarDataset::kBlockRows / 64];
+        filterColumns(chunk.prices.data() + start, chunk.mileages.data() + start, chunk.years.data() + start,
+                      count, criteria, mask);
+        if (criteria.brandCode >= 0) {
+            filterCodes(chunk.brands.data() + start, count, static_cast<StringCode>(criteria.brandCode), mask);
+        }
+        if (criteria.bodyTypeCode >= 0) {
+            filterCodes(chunk.bodyTypes.data() + start, count, static_cast<StringCode>(criteria.bodyTypeCode), mask);
+        }
+        for (size_t w = 0; w < (count + 63) / 64; ++w) {
+            uint64_t bits = mask[w];
+            while (bits) {
+                parts[b].push_back(static_cast<RowId>(start + w * 64 + countr_zero(bits)));
+                bits &= bits - 1;
+            }
+        }
+    });
+    
+    batch.firstRow = firstRow;
+    batch.rows.clear();
+    batch.cars.clear();
+    for (const auto& part : parts) {
+        for (RowId local : part) {
+            batch.rows.push_back(static_cast<RowId>(firstRow + local));
+            batch.cars.emplace_back(chunk.brands[local], chunk.prices[local], chunk.mileages[local],
+                                    chunk.bodyTypes[local], chunk.years[local]);
+        }
+    }
+}
+
+StreamScanStats streamCarFile(const CarFileReader& reader, const CarCriteria& criteria,
+                              const function<void(const StreamBatch&)>& onBatch,
+                              size_t chunkRows, ThreadPool& pool) {
+    auto scanStart = chrono::steady_clock::now();
+    
+    // Порция выравнивается по блокам, чтобы ее блоки совпадали с зонными картами файла
+    const size_t blockRows = CarDataset::kBlockRows;
+    chunkRows = max(blockRows, chunkRows / blockRows * blockRows);
+    size_t numChunks = (reader.size() + chunkRows - 1) / chunkRows;
+    
+    StreamScanStats stats;
+    stats.rows = reader.size();
+    
+    // Порции, в которых зонные карты исключают все блоки, не читаются вовсе
+    auto chunkMayMatch = [&](size_t c) {
+        size_t firstBlock = c * chunkRows / blockRows;
+        size_t lastBlock = min((c + 1) * chunkRows, reader.size());
+        lastBlock = (lastBlock + blockRows - 1) / blockRows;
+        for (size_t b = firstBlock; b < lastBlock; ++b) {
+            if (reader.getZone(b).mayMatch(criteria)) return true;
+        }
+        return false;
+    };
+    vector<size_t> toRead;
+    for (size_t c = 0; c < numChunks; ++c) {
+        if (chunkMayMatch(c)) {
+            toRead.push_back(c);
+        } else {
+            stats.chunksSkipped++;
+        }
+    }
+    
+    CarColumns buffers[2];
+    auto startRead = [&](size_t i) {
+        size_t start = toRead[i] * chunkRows;
+        size_t count = min(chunkRows, reader.size() - start);
+        return async(launch::async, [&reader, &buffers, i, start, count] {
+            return reader.readRows(start, count, buffers[i % 2]);
+        });
+    };
+    
+    StreamBatch batch;
+    future<size_t> pending;
+    if (!toRead.empty()) pending = startRead(0);
+    
+    for (size_t i = 0; i < toRead.size(); ++i) {
+        auto waitStart = chrono::steady_clock::now();
+        stats.bytesRead += pending.get();
+        stats.ioWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - waitStart).count();
+        
+        // Следующая порция читается во второй буфер, пока фильтруется текущая
+        if (i + 1 < toRead.size()) pending = startRead(i + 1);
+        
+        filterChunk(reader, buffers[i % 2], toRead[i] * chunkRows, criteria, pool, batch);
+        stats.chunks++;
+        stats.matches += batch.rows.size();
+        if (!batch.rows.empty()) onBatch(batch);
+    }
+    
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - scanStart).count();
+    return stats;
+}
+
+StreamScanStats streamCarFile(const string& path, const CarCriteria& criteria,
+                              const function<void(const StreamBatch&)>& onBatch,
+                              size_t chunkRows, ThreadPool& pool) {
+    CarFileReader reader(path);
+    return streamCarFile(reader, criteria, onBatch, chunkRows, pool);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "car.h"
+#include "car_dataset.h"
+#include "car_file.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Строк в одной порции потокового чтения (кратно размеру блока зонных карт): ~16 МБ колонок
+static constexpr size_t kStreamChunkRows = 1 << 20;
+
+// Чтение двоичного файла набора (car_file.h) порциями через pread, без отображения всего файла.
+// В памяти держатся только заголовок, зонные карты и словари.
+class CarFileReader {
+private:
+    int fd = -1;
+    string path;
+    CarFileHeader header{};
+    vector<ZoneMap> zones;
+    vector<StringCode> brandRemap;      // Коды файла -> коды словарей процесса
+    vector<StringCode> bodyTypeRemap;
+    
+    void readAt(uint64_t offset, void* buffer, size_t bytes) const;
+    
+public:
+    // Бросает runtime_error, если файл не открывается или заголовок поврежден
+    explicit CarFileReader(const string& path);
+    ~CarFileReader();
+    
+    CarFileReader(const CarFileReader&) = delete;
+    CarFileReader& operator=(const CarFileReader&) = delete;
+    
+    size_t size() const { return header.rowCount; }
+    const ZoneMap& getTotals() const { return header.totals; }
+    const ZoneMap& getZone(size_t block) const { return zones[block]; }
+    
+    // Читает строки [start, start + count) в колонки out (коды уже переведены в словари процесса).
+    // Возвращает число прочитанных байт. Можно вызывать из разных потоков для разных буферов.
+    // Бросает runtime_error, если код марки или кузова выходит за словарь файла.
+    size_t readRows(size_t start, size_t count, CarColumns& out) const;
+};
+
+// Подходящие строки одной порции
+struct StreamBatch {
+    size_t firstRow = 0;         // Первая строка порции в файле
+    vector<RowId> rows;          // Номера подходящих строк в файле, по возрастанию
+    vector<Car> cars;            // Сами автомобили в том же порядке
+};
+
+struct StreamScanStats {
+    size_t rows = 0;             // Строк в файле
+    size_t chunks = 0;           // Прочитано порций
+    size_t chunksSkipped = 0;    // Пропущено по зонным картам без чтения
+    size_t matches = 0;
+    uint64_t bytesRead = 0;
+    double seconds = 0;
+    double ioWaitSeconds = 0;    // Сколько фильтрация простаивала в ожидании чтения
+};
+
+// Потоковый просмотр файла: пока пул фильтрует текущую порцию, следующая читается
+// в другой буфер (двойная буферизация), так что ввод-вывод и вычисления перекрываются.
+// onBatch вызывается в порядке порций из вызывающего потока; память не растет с размером файла.
+StreamScanStats streamCarFile(const CarFileReader& reader, const CarCriteria& criteria,
+                              const function<void(const StreamBatch&)>& onBatch,
+                              size_t chunkRows = kStreamChunkRows, ThreadPool& pool = ThreadPool::shared());
+
+StreamScanStats streamCarFile(const string& path, const CarCriteria& criteria,
+                              const function<void(const StreamBatch&)>& onBatch,
+                              size_t chunkRows = kStreamChunkRows, ThreadPool& pool = ThreadPool::shared());
@@ -0,0 +1,347 @@
+#include "compressed_car_table.h"
+#include <array>
+#include <bit>
+#include <utility>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include "filter_kernel.h"
+#include "morsel_queue.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAR_PACKED_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static constexpr size_t kGroupRows = 64;
+
+// Распаковка groupCount групп по 64 значения ширины W; группа лежит ровно в W словах.
+// Внутренний цикл разворачивается целиком, поэтому сдвиги и номера слов становятся константами.
+// Сложение с опорным значением идет в uint32_t: результат совпадает с исходным int без переполнения.
+template <unsigned W, typename T>
+static void unpackGroups(const uint64_t* in, int base, T* out, size_t groupCount) {
+    const uint32_t ubase = static_cast<uint32_t>(base);
+    if constexpr (W == 0) {
+        fill(out, out + groupCount * kGroupRows, static_cast<T>(base));
+    } else {
+        // Значение ширины до 32 бит со сдвигом до 7 бит целиком лежит в 8 байтах от своего первого байта,
+        // поэтому хватает одного невыровненного чтения; за последним блоком колонки есть запасное слово
+        constexpr uint64_t mask = (uint64_t(1) << W) - 1;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+        for (size_t g = 0; g < groupCount; ++g, bytes += W * sizeof(uint64_t), out += kGroupRows) {
+#pragma GCC unroll 64
+            for (unsigned k = 0; k < kGroupRows; ++k) {
+                uint64_t v;
+                memcpy(&v, bytes + k * W / 8, sizeof(v));
+                out[k] = static_cast<T>(static_cast<int>(ubase + static_cast<uint32_t>((v >> (k * W % 8)) & mask)));
+            }
+        }
+    }
+}
+
+template <typename T>
+using UnpackGroupFn = void (*)(const uint64_t*, int, T*, size_t);
+
+template <typename T, size_t... W>
+static constexpr array<UnpackGroupFn<T>, sizeof...(W)> makeUnpackTable(index_sequence<W...>) {
+    return {&unpackGroups<W, T>...};
+}
+
+// Функции распаковки для всех ширин 0..32, выбираются по ширине блока
+template <typename T>
+static constexpr auto kUnpackGroups = makeUnpackTable<T>(make_index_sequence<33>());
+
+#ifdef CAR_PACKED_X86
+// Восемь значений ширины width занимают ровно width байт, поэтому смещения и сдвиги внутри
+// каждой восьмерки одинаковы: одно gather-чтение по 4 байта, сдвиг, маска и опорное значение.
+// При width <= 25 значение со сдвигом до 7 бит помещается в 4 байта.
+static constexpr unsigned kMaxGatherWidth = 25;
+
+__attribute__((target("avx2")))
+static void unpackIntsAvx2(const uint64_t* in, unsigned width, int base, int* out, size_t groupCount) {
+    alignas(32) int byteOffsets[8];
+    alignas(32) int shifts[8];
+    for (unsigned j = 0; j < 8; ++j) {
+        byteOffsets[j] = static_cast<int>(j * width / 8);
+        shifts[j] = static_cast<int>(j * width % 8);
+    }
+    const __m256i offsetVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(byteOffsets));
+    const __m256i shiftVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(shifts));
+    const __m256i maskVec = _mm256_set1_epi32(static_cast<int>((uint32_t(1) << width) - 1));
+    const __m256i baseVec = _mm256_set1_epi32(base);
+    
+    const char* bytes = reinterpret_cast<const char*>(in);
+    for (size_t i = 0; i < groupCount * kGroupRows / 8; ++i, bytes += width) {
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bytes), offsetVec, 1);
+        v = _mm256_and_si256(_mm256_srlv_epi32(v, shiftVec), maskVec);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 8), _mm256_add_epi32(v, baseVec));
+    }
+}
+#endif
+
+template <typename T>
+void PackedIntColumn::build(const T* values, size_t count, ThreadPool& pool) {
+    const size_t blockRows = CarDataset::kBlockRows;
+    size_t blockCount = (count + blockRows - 1) / blockRows;
+    bases.assign(blockCount, 0);
+    widths.assign(blockCount, 0);
+    offsets.assign(blockCount + 1, 0);
+
+    // Первый проход: опорное значение и ширина каждого блока
+    pool.parallelFor(blockCount, [&](size_t block) {
+        size_t start = block * blockRows;
+        size_t end = min(start + blockRows, count);
+        auto [lo, hi] = minmax_element(values + start, values + end);
+        bases[block] = static_cast<int>(*lo);
+        // Разность считается в uint32_t, чтобы диапазон шире INT_MAX не переполнял int
+        uint32_t range = static_cast<uint32_t>(static_cast<int>(*hi)) - static_cast<uint32_t>(static_cast<int>(*lo));
+        widths[block] = static_cast<uint8_t>(bit_width(range));
+        offsets[block + 1] = (end - start + kGroupRows - 1) / kGroupRows * widths[block];
+    });
+    inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+
+    // Второй проход: блоки пишут непересекающиеся диапазоны слов
+    words.assign(offsets.back() + 1, 0);
+    pool.parallelFor(blockCount, [&](size_t block) {
+        size_t start = block * blockRows;
+        size_t end = min(start + blockRows, count);
+        unsigned width = widths[block];
+        if (width == 0) return;
+
+        uint64_t* out = words.data() + offsets[block];
+        for (size_t i = start; i < end; ++i) {
+            uint64_t v = static_cast<uint32_t>(static_cast<int>(values[i])) - static_cast<uint32_t>(bases[block]);
+            size_t bit = (i - start) * width;
+            size_t shift = bit % 64;
+            out[bit / 64] |= v << shift;
+            if (shift + width > 64) out[bit / 64 + 1] |= v >> (64 - shift);
+        }
+    });
+}
+
+template void PackedIntColumn::build<int>(const int*, size_t, ThreadPool&);
+template void PackedIntColumn::build<StringCode>(const StringCode*, size_t, ThreadPool&);
+
+size_t PackedIntColumn::unpack(size_t block, size_t firstGroup, size_t groupCount, int* out) const {
+    unsigned width = widths[block];
+    const uint64_t* in = words.data() + offsets[block] + firstGroup * width;
+#ifdef CAR_PACKED_X86
+    if (width > 0 && width <= kMaxGatherWidth && activeFilterKernel() == FilterKernelKind::AVX2) {
+        unpackIntsAvx2(in, width, bases[block], out, groupCount);
+        return groupCount * width * sizeof(uint64_t);
+    }
+#endif
+    kUnpackGroups<int>[width](in, bases[block], out, groupCount);
+    return groupCount * width * sizeof(uint64_t);
+}
+
+size_t PackedIntColumn::unpack(size_t block, size_t firstGroup, size_t groupCount, StringCode* out) const {
+    unsigned width = widths[block];
+    const uint64_t* in = words.data() + offsets[block] + firstGroup * width;
+    kUnpackGroups<StringCode>[width](in, bases[block], out, groupCount);
+    return groupCount * width * sizeof(uint64_t);
+}
+
+int PackedIntColumn::at(size_t row) const {
+    size_t block = row / CarDataset::kBlockRows;
+    unsigned width = widths[block];
+    if (width == 0) return bases[block];
+
+    const uint64_t* in = words.data() + offsets[block];
+    size_t bit = row % CarDataset::kBlockRows * width;
+    size_t shift = bit % 64;
+    uint64_t v = in[bit / 64] >> shift;
+    if (shift + width > 64) v |= in[bit / 64 + 1] << (64 - shift);
+    return static_cast<int>(static_cast<uint32_t>(bases[block]) + static_cast<uint32_t>(v & ((uint64_t(1) << width) - 1)));
+}
+
+size_t PackedIntColumn::memoryBytes() const {
+    return words.size() * sizeof(uint64_t) + bases.size() * sizeof(int) + widths.size() * sizeof(uint8_t) +
+           offsets.size() * sizeof(size_t);
+}
+
+CompressedCarTable::CompressedCarTable(const CarDataset& data, ThreadPool& pool) : rowCount(data.size()), pool(pool) {
+    prices.build(data.getPrices(), rowCount, pool);
+    mileages.build(data.getMileages(), rowCount, pool);
+    years.build(data.getYears(), rowCount, pool);
+    brands.build(data.getBrands(), rowCount, pool);
+    bodyTypes.build(data.getBodyTypes(), rowCount, pool);
+    zones.resize(data.getBlockCount());
+    for (size_t block = 0; block < zones.size(); ++block) {
+        zones[block] = data.getZone(block);
+    }
+}
+
+Car CompressedCarTable::get(RowId row) const {
+    return Car(static_cast<StringCode>(brands.at(row)), prices.at(row), mileages.at(row),
+               static_cast<StringCode>(bodyTypes.at(row)), years.at(row));
+}
+
+CarColumns CompressedCarTable::decompress() const {
+    CarColumns columns;
+    columns.resize(rowCount);
+    pool.parallelFor(zones.size(), [&](size_t block) {
+        size_t start = block * kBlockRows;
+        size_t count = min(kBlockRows, rowCount - start);
+        size_t groups = (count + kGroupRows - 1) / kGroupRows;
+        int values[kBlockRows];
+        StringCode codes[kBlockRows];
+
+        prices.unpack(block, 0, groups, values);
+        copy(values, values + count, columns.prices.begin() + start);
+        mileages.unpack(block, 0, groups, values);
+        copy(values, values + count, columns.mileages.begin() + start);
+        years.unpack(block, 0, groups, values);
+        copy(values, values + count, columns.years.begin() + start);
+        brands.unpack(block, 0, groups, codes);
+        copy(codes, codes + count, columns.brands.begin() + start);
+        bodyTypes.unpack(block, 0, groups, codes);
+        copy(codes, codes + count, columns.bodyTypes.begin() + start);
+    });
+    return columns;
+}
+
+// Код, которого нет в диапазоне упакованных значений блока, исключает весь блок
+static bool codeMayMatch(const PackedIntColumn& column, size_t block, int code) {
+    return code < 0 || (code >= column.getBase(block) && code <= column.getUpperBound(block));
+}
+
+template <typename OnBatch>
+void CompressedCarTable::scan(const CarCriteria& criteria, int numThreads, bool needValues, ScanStats* stats,
+                              OnBatch onBatch) const {
+    auto queryStart = ScanClock::now();
+    if (numThreads < 1) numThreads = 1;
+    size_t numTasks = numThreads;
+    vector<ScanStats> partStats(numTasks);
+    MorselQueue queue(morselCount(), 1);
+
+    pool.parallelFor(numTasks, [&](size_t t) {
+        auto taskStart = ScanClock::now();
+        ScanStats& local = partStats[t];
+        int priceBuf[kMicroBatchRows], mileageBuf[kMicroBatchRows], yearBuf[kMicroBatchRows];
+        StringCode codeBuf[kMicroBatchRows];
+        uint64_t mask[kMicroBatchRows / 64];
+        size_t m;
+        bool stolen;
+
+        while (queue.pop(t, m, stolen)) {
+            local.morsels++;
+            size_t lastBlock = min((m + 1) * kMorselBlocks, zones.size());
+            for (size_t block = m * kMorselBlocks; block < lastBlock; ++block) {
+                size_t blockStart = block * kBlockRows;
+                size_t blockCount = min(kBlockRows, rowCount - blockStart);
+                const ZoneMap& zone = zones[block];
+                local.blocksTotal++;
+
+                if (!zone.mayMatch(criteria) || !codeMayMatch(brands, block, criteria.brandCode) ||
+                    !codeMayMatch(bodyTypes, block, criteria.bodyTypeCode)) {
+                    local.blocksSkipped++;
+                    continue;
+                }
+                bool allMatch = zone.allMatch(criteria);
+                local.blocksFullMatch += allMatch;
+                local.rowsScanned += blockCount;
+
+                for (size_t first = 0; first < blockCount; first += kMicroBatchRows) {
+                    size_t count = min(kMicroBatchRows, blockCount - first);
+                    size_t groups = (count + kGroupRows - 1) / kGroupRows;
+                    size_t firstGroup = first / kGroupRows;
+
+                    if (allMatch) {
+                        fill(mask, mask + groups, ~uint64_t(0));
+                        if (count % 64) mask[groups - 1] = (uint64_t(1) << (count % 64)) - 1;
+                        if (needValues) {
+                            local.bytesTouched += prices.unpack(block, firstGroup, groups, priceBuf);
+                            local.bytesTouched += mileages.unpack(block, firstGroup, groups, mileageBuf);
+                        }
+                    } else {
+                        local.bytesTouched += prices.unpack(block, firstGroup, groups, priceBuf);
+                        local.bytesTouched += mileages.unpack(block, firstGroup, groups, mileageBuf);
+                        local.bytesTouched += years.unpack(block, firstGroup, groups, yearBuf);
+                        filterColumns(priceBuf, mileageBuf, yearBuf, count, criteria, mask);
+                        if (criteria.brandCode >= 0) {
+                            local.bytesTouched += brands.unpack(block, firstGroup, groups, codeBuf);
+                            filterCodes(codeBuf, count, static_cast<StringCode>(criteria.brandCode), mask);
+                        }
+                        if (criteria.bodyTypeCode >= 0) {
+                            local.bytesTouched += bodyTypes.unpack(block, firstGroup, groups, codeBuf);
+                            filterCodes(codeBuf, count, static_cast<StringCode>(criteria.bodyTypeCode), mask);
+                        }
+                    }
+                    onBatch(t, m, blockStart + first, count, mask, priceBuf, mileageBuf);
+                }
+            }
+        }
+        local.taskSeconds.push_back(secondsSince(taskStart));
+    });
+
+    if (stats) {
+        *stats = ScanStats();
+        for (const auto& part : partStats) {
+            stats->merge(part);
+        }
+        stats->totalSeconds = secondsSince(queryStart);
+    }
+}
+
+vector<RowId> CompressedCarTable::select(const CarCriteria& criteria, int numThreads, ScanStats* stats) const {
+    // Буфер на морсель: склеенные по порядку морселей, строки идут по возрастанию
+    vector<vector<RowId>> parts(morselCount());
+    scan(criteria, numThreads, false, stats,
+         [&](size_t, size_t m, size_t firstRow, size_t count, const uint64_t* mask, const int*, const int*) {
+             for (size_t w = 0; w < (count + 63) / 64; ++w) {
+                 uint64_t bits = mask[w];
+                 while (bits) {
+                     parts[m].push_back(static_cast<RowId>(firstRow + w * 64 + countr_zero(bits)));
+                     bits &= bits - 1;
+                 }
+             }
+         });
+
+    auto mergeStart = ScanClock::now();
+    vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = parts[i].size();
+    }
+    inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    vector<RowId> rows(offsets.back());
+    pool.parallelFor(parts.size(), [&](size_t i) {
+        copy(parts[i].begin(), parts[i].end(), rows.begin() + offsets[i]);
+    });
+
+    if (stats) {
+        stats->rowsMatched = rows.size();
+        stats->mergeSeconds = secondsSince(mergeStart);
+        stats->totalSeconds += stats->mergeSeconds;
+    }
+    return rows;
+}
+
+CarAggregate CompressedCarTable::aggregate(const CarCriteria& criteria, int numThreads, ScanStats* stats) const {
+    vector<CarAggregate> parts(max(numThreads, 1));
+    scan(criteria, numThreads, true, stats,
+         [&](size_t t, size_t, size_t, size_t count, const uint64_t* mask, const int* price, const int* mileage) {
+             for (size_t w = 0; w < (count + 63) / 64; ++w) {
+                 uint64_t bits = mask[w];
+                 while (bits) {
+                     size_t i = w * 64 + countr_zero(bits);
+                     parts[t].add(price[i], mileage[i]);
+                     bits &= bits - 1;
+                 }
+             }
+         });
+
+    CarAggregate total;
+    for (const auto& part : parts) {
+        total.merge(part);
+    }
+    if (stats) stats->rowsMatched = total.count;
+    return total;
+}
+
+size_t CompressedCarTable::memoryBytes() const {
+    return prices.memoryBytes() + mileages.memoryBytes() + years.memoryBytes() + brands.memoryBytes() +
+           bodyTypes.memoryBytes() + zones.size() * sizeof(ZoneMap);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "car.h"
+#include "car_aggregate.h"
+#include "car_dataset.h"
+#include "car_processor.h"
+#include "zone_map.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Колонка целых чисел, упакованная по блокам из CarDataset::kBlockRows строк.
+// В каждом блоке хранится опорное значение (минимум блока) и ширина в битах, достаточная
+// для разности max - min; значения записываются как разности подряд, без выравнивания.
+// Каждые 64 значения занимают ровно width слов, поэтому распаковка идет группами по 64:
+// AVX2 распаковывает по 8 значений за gather-чтение, остальные случаи - развернутый цикл
+// с шириной, известной при компиляции (см. compressed_car_table.cpp).
+class PackedIntColumn {
+private:
+    vector<uint64_t> words;
+    vector<int> bases;               // Опорное значение блока
+    vector<uint8_t> widths;          // Бит на значение, 0..32
+    vector<size_t> offsets;          // Первое слово блока в words
+
+public:
+    // Упаковывает values[0, count); блоки пакуются параллельно
+    template <typename T>
+    void build(const T* values, size_t count, ThreadPool& pool);
+
+    // Распаковывает группы [firstGroup, firstGroup + groupCount) блока в out (64 значения на группу).
+    // Возвращает число прочитанных байт упакованных данных.
+    size_t unpack(size_t block, size_t firstGroup, size_t groupCount, int* out) const;
+    size_t unpack(size_t block, size_t firstGroup, size_t groupCount, StringCode* out) const;
+
+    int at(size_t row) const;
+
+    int getBase(size_t block) const { return bases[block]; }
+    unsigned getWidth(size_t block) const { return widths[block]; }
+
+    // Наибольшее значение, которое может встретиться в блоке
+    long long getUpperBound(size_t block) const { return bases[block] + ((1LL << widths[block]) - 1); }
+
+    size_t memoryBytes() const;
+};
+
+// Сжатое неизменяемое представление набора для полного просмотра.
+// Все пять полей упакованы по блокам (цена около 17 бит, пробег 19, год 6 вместо 32),
+// зонные карты сохраняются. Условия проверяются по микропорциям: порция из kMicroBatchRows строк
+// распаковывается в буферы, которые помещаются в L1, и проверяется тем же SIMD-ядром,
+// что и обычные колонки. Из памяти читаются только упакованные биты, поэтому выигрыш заметен,
+// когда просмотр упирается в пропускную способность памяти (много потоков, данные не в кэше);
+// на одном ядре распаковка стоит дороже сэкономленного чтения.
+class CompressedCarTable {
+private:
+    size_t rowCount = 0;
+    PackedIntColumn prices;
+    PackedIntColumn mileages;
+    PackedIntColumn years;
+    PackedIntColumn brands;
+    PackedIntColumn bodyTypes;
+    vector<ZoneMap> zones;
+    ThreadPool& pool;
+
+    size_t morselCount() const { return (zones.size() + kMorselBlocks - 1) / kMorselBlocks; }
+
+    // Просмотр морселями по kMorselBlocks блоков. Для каждой микропорции с подходящими строками
+    // вызывается onBatch(задача, морсель, первая строка, число строк, маска, цены, пробеги);
+    // цены и пробеги распакованы, только если needValues.
+    template <typename OnBatch>
+    void scan(const CarCriteria& criteria, int numThreads, bool needValues, ScanStats* stats, OnBatch onBatch) const;
+
+public:
+    static constexpr size_t kBlockRows = CarDataset::kBlockRows;
+    static constexpr size_t kMicroBatchRows = 1024;   // 3 колонки по 4 КБ
+    static constexpr size_t kMorselBlocks = 4;
+
+    // Сжимает колонки снимка; сам снимок после этого не нужен
+    explicit CompressedCarTable(const CarDataset& data, ThreadPool& pool = ThreadPool::shared());
+
+    CompressedCarTable(const CompressedCarTable&) = delete;
+    CompressedCarTable& operator=(const CompressedCarTable&) = delete;
+
+    size_t size() const { return rowCount; }
+
+    // Распаковка одной строки
+    Car get(RowId row) const;
+
+    // Полная распаковка (например, чтобы снова собрать CarDataset)
+    CarColumns decompress() const;
+
+    // Номера подходящих строк по возрастанию, как у CarProcessor::selectMultiThread.
+    // Если stats не nullptr, туда пишется статистика просмотра (байты - упакованные).
+    vector<RowId> select(const CarCriteria& criteria, int numThreads, ScanStats* stats = nullptr) const;
+
+    CarAggregate aggregate(const CarCriteria& criteria, int numThreads, ScanStats* stats = nullptr) const;
+
+    // Упакованные колонки и зонные карты
+    size_t memoryBytes() const;
+
+    // Те же пять колонок без сжатия: 3 * 4 + 2 * 2 байта на строку
+    size_t uncompressedBytes() const { return rowCount * (3 * sizeof(int) + 2 * sizeof(StringCode)); }
+};
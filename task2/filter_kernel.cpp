@@ -0,0 +1,213 @@
+#include "filter_kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAR_FILTER_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Маска для не более чем 64 строк, начиная с указанных указателей
+static inline uint64_t scalarWord(const int* price, const int* mileage, const int* year, size_t count,
+                                  const CarCriteria& c) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // Без ветвлений: результат сравнения сразу сдвигается в нужный бит
+        uint64_t pass = (price[i] >= c.minPrice) & (price[i] <= c.maxPrice) &
+                        (mileage[i] <= c.maxMileage) & (year[i] >= c.minYear);
+        bits |= pass << i;
+    }
+    return bits;
+}
+
+void filterColumnsScalar(const int* price, const int* mileage, const int* year, size_t count,
+                         const CarCriteria& criteria, uint64_t* mask) {
+    for (size_t base = 0, w = 0; base < count; base += 64, ++w) {
+        size_t n = (count - base < 64) ? count - base : 64;
+        mask[w] = scalarWord(price + base, mileage + base, year + base, n, criteria);
+    }
+}
+
+static inline uint64_t scalarCodeWord(const StringCode* codes, size_t count, StringCode code) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bits |= static_cast<uint64_t>(codes[i] == code) << i;
+    }
+    return bits;
+}
+
+static void filterCodesScalar(const StringCode* codes, size_t count, StringCode code, uint64_t* mask) {
+    for (size_t base = 0, w = 0; base < count; base += 64, ++w) {
+        size_t n = (count - base < 64) ? count - base : 64;
+        mask[w] &= scalarCodeWord(codes + base, n, code);
+    }
+}
+
+#ifdef CAR_FILTER_X86
+
+// AVX2: 16 кодов за сравнение; результаты упаковываются в байты для movemask
+__attribute__((target("avx2")))
+static void filterCodesAvx2(const StringCode* codes, size_t count, StringCode code, uint64_t* mask) {
+    const __m256i target = _mm256_set1_epi16(static_cast<short>(code));
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; ++w) {
+        uint64_t bits = 0;
+        for (int k = 0; k < 4; ++k) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + w * 64 + k * 16));
+            __m256i eq = _mm256_cmpeq_epi16(c, target);
+            __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(eq), _mm256_extracti128_si256(eq, 1));
+            bits |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(packed)) & 0xFFFFu) << (k * 16);
+        }
+        mask[w] &= bits;
+    }
+    
+    size_t base = fullWords * 64;
+    if (base < count) {
+        mask[fullWords] &= scalarCodeWord(codes + base, count - base, code);
+    }
+}
+
+// SSE2: 8 кодов за сравнение
+__attribute__((target("sse2")))
+static void filterCodesSse2(const StringCode* codes, size_t count, StringCode code, uint64_t* mask) {
+    const __m128i target = _mm_set1_epi16(static_cast<short>(code));
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; ++w) {
+        uint64_t bits = 0;
+        for (int k = 0; k < 8; ++k) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + w * 64 + k * 8));
+            __m128i packed = _mm_packs_epi16(_mm_cmpeq_epi16(c, target), _mm_setzero_si128());
+            bits |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(packed)) & 0xFFu) << (k * 8);
+        }
+        mask[w] &= bits;
+    }
+    
+    size_t base = fullWords * 64;
+    if (base < count) {
+        mask[fullWords] &= scalarCodeWord(codes + base, count - base, code);
+    }
+}
+
+// AVX2: 8 строк за сравнение, 8 сравнений на одно слово маски
+__attribute__((target("avx2")))
+static void filterColumnsAvx2(const int* price, const int* mileage, const int* year, size_t count,
+                              const CarCriteria& c, uint64_t* mask) {
+    const __m256i minP = _mm256_set1_epi32(c.minPrice);
+    const __m256i maxP = _mm256_set1_epi32(c.maxPrice);
+    const __m256i maxM = _mm256_set1_epi32(c.maxMileage);
+    const __m256i minY = _mm256_set1_epi32(c.minYear);
+
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; ++w) {
+        uint64_t bits = 0;
+        for (int k = 0; k < 8; ++k) {
+            size_t i = w * 64 + k * 8;
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(price + i));
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mileage + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(year + i));
+
+            // Строка не подходит, если нарушено хотя бы одно условие
+            __m256i fail = _mm256_or_si256(_mm256_cmpgt_epi32(minP, p), _mm256_cmpgt_epi32(p, maxP));
+            fail = _mm256_or_si256(fail, _mm256_cmpgt_epi32(m, maxM));
+            fail = _mm256_or_si256(fail, _mm256_cmpgt_epi32(minY, y));
+
+            uint64_t pass = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(fail))) & 0xFFu;
+            bits |= pass << (k * 8);
+        }
+        mask[w] = bits;
+    }
+
+    size_t base = fullWords * 64;
+    if (base < count) {
+        mask[fullWords] = scalarWord(price + base, mileage + base, year + base, count - base, c);
+    }
+}
+
+// SSE2: 4 строки за сравнение, 16 сравнений на одно слово маски
+__attribute__((target("sse2")))
+static void filterColumnsSse2(const int* price, const int* mileage, const int* year, size_t count,
+                              const CarCriteria& c, uint64_t* mask) {
+    const __m128i minP = _mm_set1_epi32(c.minPrice);
+    const __m128i maxP = _mm_set1_epi32(c.maxPrice);
+    const __m128i maxM = _mm_set1_epi32(c.maxMileage);
+    const __m128i minY = _mm_set1_epi32(c.minYear);
+
+    size_t fullWords = count / 64;
+    for (size_t w = 0; w < fullWords; ++w) {
+        uint64_t bits = 0;
+        for (int k = 0; k < 16; ++k) {
+            size_t i = w * 64 + k * 4;
+            __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(price + i));
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mileage + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(year + i));
+
+            __m128i fail = _mm_or_si128(_mm_cmpgt_epi32(minP, p), _mm_cmpgt_epi32(p, maxP));
+            fail = _mm_or_si128(fail, _mm_cmpgt_epi32(m, maxM));
+            fail = _mm_or_si128(fail, _mm_cmpgt_epi32(minY, y));
+
+            uint64_t pass = ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(fail))) & 0xFu;
+            bits |= pass << (k * 4);
+        }
+        mask[w] = bits;
+    }
+
+    size_t base = fullWords * 64;
+    if (base < count) {
+        mask[fullWords] = scalarWord(price + base, mileage + base, year + base, count - base, c);
+    }
+}
+
+#endif
+
+static FilterKernelKind detectFilterKernel() {
+#ifdef CAR_FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return FilterKernelKind::AVX2;
+    if (__builtin_cpu_supports("sse2")) return FilterKernelKind::SSE2;
+#endif
+    return FilterKernelKind::Scalar;
+}
+
+FilterKernelKind activeFilterKernel() {
+    static const FilterKernelKind kind = detectFilterKernel();
+    return kind;
+}
+
+const char* filterKernelName(FilterKernelKind kind) {
+    switch (kind) {
+        case FilterKernelKind::AVX2: return "AVX2";
+        case FilterKernelKind::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+void filterColumns(const int* price, const int* mileage, const int* year, size_t count,
+                   const CarCriteria& criteria, uint64_t* mask) {
+    switch (activeFilterKernel()) {
+#ifdef CAR_FILTER_X86
+        case FilterKernelKind::AVX2:
+            filterColumnsAvx2(price, mileage, year, count, criteria, mask);
+            return;
+        case FilterKernelKind::SSE2:
+            filterColumnsSse2(price, mileage, year, count, criteria, mask);
+            return;
+#endif
+        default:
+            filterColumnsScalar(price, mileage, year, count, criteria, mask);
+    }
+}
+
+void filterCodes(const StringCode* codes, size_t count, StringCode code, uint64_t* mask) {
+    switch (activeFilterKernel()) {
+#ifdef CAR_FILTER_X86
+        case FilterKernelKind::AVX2:
+            filterCodesAvx2(codes, count, code, mask);
+            return;
+        case FilterKernelKind::SSE2:
+            filterCodesSse2(codes, count, code, mask);
+            return;
+#endif
+        default:
+            filterCodesScalar(codes, count, code, mask);
+    }
+}
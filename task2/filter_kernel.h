@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "car.h"
+
+using namespace std;
+
+// Реализация ядра фильтрации, выбранная при первом вызове
+enum class FilterKernelKind {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Проверяет критерии по колонкам price/mileage/year для строк [0, count)
+// и записывает маску выборки: бит i слова i / 64 равен 1, если строка подходит.
+// mask должна вмещать (count + 63) / 64 слов.
+void filterColumns(const int* price, const int* mileage, const int* year, size_t count,
+                   const CarCriteria& criteria, uint64_t* mask);
+
+// Сужает готовую маску до строк, у которых код словаря равен code
+void filterCodes(const StringCode* codes, size_t count, StringCode code, uint64_t* mask);
+
+// Скалярная версия ядра (используется как запасной вариант и для проверки)
+void filterColumnsScalar(const int* price, const int* mileage, const int* year, size_t count,
+                         const CarCriteria& criteria, uint64_t* mask);
+
+FilterKernelKind activeFilterKernel();
+const char* filterKernelName(FilterKernelKind kind);
@@ -0,0 +1,203 @@
+#include "live_car_store.h"
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "filter_kernel.h"
+
+using namespace std;
+
+// Размер части при первичном просмотре; кратен 64, чтобы задачи писали в разные слова карт
+static constexpr size_t kEvaluateRows = CarDataset::kBlockRows;
+
+LiveCarStore::LiveCarStore(ThreadPool& pool) : pool(pool) {}
+
+LiveCarStore::LiveCarStore(const CarDataset& initial, ThreadPool& pool) : pool(pool) {
+    size_t n = initial.size();
+    columns.prices.assign(initial.getPrices(), initial.getPrices() + n);
+    columns.mileages.assign(initial.getMileages(), initial.getMileages() + n);
+    columns.years.assign(initial.getYears(), initial.getYears() + n);
+    columns.brands.assign(initial.getBrands(), initial.getBrands() + n);
+    columns.bodyTypes.assign(initial.getBodyTypes(), initial.getBodyTypes() + n);
+    live.resize(n);
+    live.setRange(0, n);
+    liveCount = n;
+}
+
+bool LiveCarStore::matches(const CarCriteria& c, RowId row) const {
+    return columns.prices[row] >= c.minPrice && columns.prices[row] <= c.maxPrice &&
+           columns.mileages[row] <= c.maxMileage && columns.years[row] >= c.minYear &&
+           (c.brandCode < 0 || columns.brands[row] == c.brandCode) &&
+           (c.bodyTypeCode < 0 || columns.bodyTypes[row] == c.bodyTypeCode);
+}
+
+void LiveCarStore::checkLive(RowId row) const {
+    if (row >= columns.size() || !live.test(row)) {
+        throw out_of_range("LiveCarStore: строка " + to_string(row) + " не существует");
+    }
+}
+
+void LiveCarStore::reevaluate(RowId row) {
+    bool isLiveRow = live.test(row);
+    for (auto& query : queries) {
+        if (!query->active) continue;
+        bool was = query->rows.test(row);
+        bool now = isLiveRow && matches(query->criteria, row);
+        if (was == now) continue;
+        
+        if (now) {
+            query->rows.set(row);
+            query->count++;
+        } else {
+            query->rows.reset(row);
+            query->count--;
+        }
+        if (query->listener) query->listener(row, now);
+    }
+}
+
+void LiveCarStore::evaluateAll(StandingQuery& query) {
+    size_t n = columns.size();
+    query.rows = SelectionBitmap(n);
+    size_t numParts = (n + kEvaluateRows - 1) / kEvaluateRows;
+    vector<size_t> counts(numParts, 0);
+    
+    pool.parallelFor(numParts, [&](size_t part) {
+        size_t start = part * kEvaluateRows;
+        size_t count = min(kEvaluateRows, n - start);
+        uint64_t* mask = query.rows.data() + start / 64;
+        const CarCriteria& c = query.criteria;
+        
+        filterColumns(columns.prices.data() + start, columns.mileages.data() + start, columns.years.data() + start,
+                      count, c, mask);
+        if (c.brandCode >= 0) {
+            filterCodes(columns.brands.data() + start, count, static_cast<StringCode>(c.brandCode), mask);
+        }
+        if (c.bodyTypeCode >= 0) {
+            filterCodes(columns.bodyTypes.data() + start, count, static_cast<StringCode>(c.bodyTypeCode), mask);
+        }
+        
+        // Удаленные строки в результат не входят
+        const uint64_t* liveWords = live.data() + start / 64;
+        for (size_t w = 0; w < (count + 63) / 64; ++w) {
+            mask[w] &= liveWords[w];
+            counts[part] += popcount(mask[w]);
+        }
+    });
+    
+    query.count = 0;
+    for (size_t c : counts) query.count += c;
+}
+
+LiveCarStore::StandingQuery& LiveCarStore::queryAt(StandingQueryId id) const {
+    if (id >= queries.size() || !queries[id]->active) {
+        throw out_of_range("LiveCarStore: запрос " + to_string(id) + " не зарегистрирован");
+    }
+    return *queries[id];
+}
+
+RowId LiveCarStore::append(const Car& car) {
+    unique_lock<shared_mutex> lock(storeMutex);
+    RowId row = static_cast<RowId>(columns.size());
+    columns.prices.push_back(car.price);
+    columns.mileages.push_back(car.mileage);
+    columns.years.push_back(car.year);
+    columns.brands.push_back(car.brand);
+    columns.bodyTypes.push_back(car.bodyType);
+    
+    live.resize(row + 1);
+    live.set(row);
+    liveCount++;
+    for (auto& query : queries) {
+        if (query->active) query->rows.resize(row + 1);
+    }
+    reevaluate(row);
+    return row;
+}
+
+void LiveCarStore::update(RowId row, const Car& car) {
+    unique_lock<shared_mutex> lock(storeMutex);
+    checkLive(row);
+    columns.prices[row] = car.price;
+    columns.mileages[row] = car.mileage;
+    columns.years[row] = car.year;
+    columns.brands[row] = car.brand;
+    columns.bodyTypes[row] = car.bodyType;
+    reevaluate(row);
+}
+
+void LiveCarStore::remove(RowId row) {
+    unique_lock<shared_mutex> lock(storeMutex);
+    checkLive(row);
+    live.reset(row);
+    liveCount--;
+    reevaluate(row);
+}
+
+size_t LiveCarStore::size() const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    return columns.size();
+}
+
+size_t LiveCarStore::getLiveCount() const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    return liveCount;
+}
+
+bool LiveCarStore::isLive(RowId row) const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    return row < columns.size() && live.test(row);
+}
+
+Car LiveCarStore::get(RowId row) const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    checkLive(row);
+    return Car(columns.brands[row], columns.prices[row], columns.mileages[row], columns.bodyTypes[row], columns.years[row]);
+}
+
+StandingQueryId LiveCarStore::registerQuery(const CarCriteria& criteria, StandingQueryListener listener) {
+    unique_lock<shared_mutex> lock(storeMutex);
+    auto query = make_unique<StandingQuery>();
+    query->criteria = criteria;
+    query->listener = move(listener);
+    evaluateAll(*query);
+    queries.push_back(move(query));
+    return queries.size() - 1;
+}
+
+void LiveCarStore::unregisterQuery(StandingQueryId id) {
+    unique_lock<shared_mutex> lock(storeMutex);
+    StandingQuery& query = queryAt(id);
+    query.active = false;
+    query.rows = SelectionBitmap();
+    query.listener = nullptr;
+}
+
+size_t LiveCarStore::getQueryCount(StandingQueryId id) const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    return queryAt(id).count;
+}
+
+vector<RowId> LiveCarStore::getQueryRows(StandingQueryId id) const {
+    shared_lock<shared_mutex> lock(storeMutex);
+    return queryAt(id).rows.toRows();
+}
+
+shared_ptr<const CarDataset> LiveCarStore::snapshot(bool buildIndexes) const {
+    CarColumns compacted;
+    {
+        shared_lock<shared_mutex> lock(storeMutex);
+        compacted.resize(liveCount);
+        size_t pos = 0;
+        for (RowId row : live.toRows()) {
+            compacted.prices[pos] = columns.prices[row];
+            compacted.mileages[pos] = columns.mileages[row];
+            compacted.years[pos] = columns.years[row];
+            compacted.brands[pos] = columns.brands[row];
+            compacted.bodyTypes[pos] = columns.bodyTypes[row];
+            pos++;
+        }
+    }
+    return CarDataset::create(move(compacted), buildIndexes, pool);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <shared_mutex>
+#include "car.h"
+#include "car_dataset.h"
+#include "selection_bitmap.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+using StandingQueryId = size_t;
+
+// Вызывается при изменении результата постоянного запроса: строка вошла в него (entered) или вышла
+using StandingQueryListener = function<void(RowId row, bool entered)>;
+
+// Изменяемое хранилище объявлений для потока изменений.
+// Номер строки выдается при добавлении и не меняется; удаленная строка остается пустым местом.
+// Постоянные запросы держат битовую карту своих строк: при изменении одной строки
+// проверяется только она, повторного просмотра всего набора нет.
+// Для тяжелых разовых запросов snapshot() публикует неизменяемый CarDataset.
+class LiveCarStore {
+private:
+    struct StandingQuery {
+        CarCriteria criteria;
+        SelectionBitmap rows;
+        size_t count = 0;
+        StandingQueryListener listener;
+        bool active = true;
+    };
+    
+    CarColumns columns;
+    SelectionBitmap live;                        // Строки, которые не удалены
+    size_t liveCount = 0;
+    vector<unique_ptr<StandingQuery>> queries;   // Номер запроса - позиция в векторе
+    ThreadPool& pool;
+    mutable shared_mutex storeMutex;
+    
+    bool matches(const CarCriteria& criteria, RowId row) const;
+    void checkLive(RowId row) const;
+    
+    // Обновление всех постоянных запросов после изменения одной строки
+    void reevaluate(RowId row);
+    
+    // Первичное заполнение запроса полным параллельным просмотром
+    void evaluateAll(StandingQuery& query);
+    
+    StandingQuery& queryAt(StandingQueryId id) const;
+    
+public:
+    explicit LiveCarStore(ThreadPool& pool = ThreadPool::shared());
+    
+    // Начальное наполнение из снимка (например, загруженного из файла)
+    explicit LiveCarStore(const CarDataset& initial, ThreadPool& pool = ThreadPool::shared());
+    
+    LiveCarStore(const LiveCarStore&) = delete;
+    LiveCarStore& operator=(const LiveCarStore&) = delete;
+    
+    RowId append(const Car& car);
+    
+    // Изменение и удаление существующей строки; для удаленной или несуществующей - out_of_range
+    void update(RowId row, const Car& car);
+    void remove(RowId row);
+    
+    // Выданные номера строк, включая удаленные
+    size_t size() const;
+    size_t getLiveCount() const;
+    bool isLive(RowId row) const;
+    Car get(RowId row) const;
+    
+    // Регистрирует постоянный запрос и сразу вычисляет его по текущим данным.
+    // Слушатель вызывается под блокировкой хранилища и не должен обращаться к нему.
+    StandingQueryId registerQuery(const CarCriteria& criteria, StandingQueryListener listener = nullptr);
+    void unregisterQuery(StandingQueryId id);
+    
+    size_t getQueryCount(StandingQueryId id) const;
+    vector<RowId> getQueryRows(StandingQueryId id) const;
+    
+    // Неизменяемый снимок живых строк; номера строк в нем идут подряд, без удаленных
+    shared_ptr<const CarDataset> snapshot(bool buildIndexes = false) const;
+};
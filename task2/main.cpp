@@ -3,13 +3,25 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <algorithm>
 #include <random>
 #include <limits>
 #include <iomanip>
-#include <climits>
+#include <filesystem>
+#include <cstdlib>
+#include <unistd.h>
 #include "car.h"
+#include "car_dataset.h"
+#include "car_generator.h"
+#include "car_csv.h"
 #include "car_processor.h"
+#include "query_cache.h"
+#include "live_car_store.h"
+#include "car_stream.h"
+#include "shard_coordinator.h"
+#include "filter_kernel.h"
+#include "compressed_car_table.h"
 
 using namespace std;
 
@@ -33,85 +45,167 @@ int inputInt(const string& prompt, int minValue, int maxValue) {
     }
 }
 
-// Функция для генерации случайного автомобиля
-Car generateRandomCar(int index, mt19937& gen) {
-    vector<string> brands = {"Toyota", "Honda", "BMW", "Audi", "Ford", 
-                            "Mercedes", "Volkswagen", "Hyundai", "Kia", 
-                            "Nissan", "Mazda", "Subaru", "Lexus", "Volvo",
-                            "Chevrolet", "Renault", "Peugeot", "Skoda", "Citroen"};
-    vector<string> bodyTypes = {"Седан", "Хэтчбек", "Внедорожник", 
-                               "Кроссовер", "Универсал", "Купе", "Минивэн", "Пикап"};
-    
-    uniform_int_distribution<> brandDist(0, brands.size() - 1);
-    uniform_int_distribution<> priceDist(5000, 100000);
-    uniform_int_distribution<> mileageDist(0, 300000);
-    uniform_int_distribution<> bodyDist(0, bodyTypes.size() - 1);
-    uniform_int_distribution<> yearDist(1990, 2024);
-    
-    return Car(
-        brands[brandDist(gen)] + " Model-" + to_string(2000 + index % 25),
-        priceDist(gen),
-        mileageDist(gen),
-        bodyTypes[bodyDist(gen)],
-        yearDist(gen)
-    );
-}
-
 // Функция для генерации тестовых данных
-vector<Car> generateTestData(int dataSize) {
-    cout << endl << "Генерация тестовых данных..." << endl;
-    vector<Car> cars;
-    cars.reserve(dataSize);
+vector<Car> generateTestData(int dataSize, uint64_t seed) {
+    cout << endl << "Генерация тестовых данных (зерно " << seed << ", потоков пула: "
+         << ThreadPool::shared().getThreadCount() << ")..." << endl;
     
-    random_device rd;
-    mt19937 gen(rd());
-    
-    for (int i = 0; i < dataSize; ++i) {
-        cars.push_back(generateRandomCar(i, gen));
-        
-        // Показываем прогресс для больших наборов данных
-        if (dataSize >= 100000 && (i + 1) % (dataSize / 10) == 0) {
-            cout << "Сгенерировано: " << (i + 1) << " из " << dataSize  << " автомобилей (" << ((i + 1) * 100 / dataSize) << "%)" << endl;
-        }
-    }
+    auto start = chrono::high_resolution_clock::now();
+    vector<Car> cars = generateCars(dataSize, seed);
+    auto end = chrono::high_resolution_clock::now();
+    cout << "Сгенерировано за " << fixed << setprecision(3) << chrono::duration<double>(end - start).count() << " секунд" << endl;
     
     // Вычисляем статистику по сгенерированным данным
     if (dataSize > 0) {
-        int minPrice = INT_MAX, maxPrice = 0;
-        int minYear = INT_MAX, maxYear = 0;
-        int totalMileage = 0;
-        
-        for (const auto& car : cars) {
-            if (car.price < minPrice) minPrice = car.price;
-            if (car.price > maxPrice) maxPrice = car.price;
-            if (car.year < minYear) minYear = car.year;
-            if (car.year > maxYear) maxYear = car.year;
-            totalMileage += car.mileage;
-        }
+        CarDataStats stats = computeStats(cars);
         
         cout << endl << "СТАТИСТИКА СГЕНЕРИРОВАННЫХ ДАННЫХ" << endl;
-        cout << "Всего автомобилей: " << dataSize << endl;
-        cout << "Диапазон цен: от " << minPrice << " до " << maxPrice << endl;
-        cout << "Диапазон годов выпуска: от " << minYear << " до " << maxYear << endl;
-        cout << "Средний пробег: " << (totalMileage / dataSize) << " км" << endl;
+        cout << "Всего автомобилей: " << stats.count << endl;
+        cout << "Диапазон цен: от " << stats.minPrice << " до " << stats.maxPrice << endl;
+        cout << "Диапазон годов выпуска: от " << stats.minYear << " до " << stats.maxYear << endl;
+        cout << "Средний пробег: " << static_cast<long long>(stats.averageMileage()) << " км" << endl;
     }
     
     return cars;
 }
 
-int main() {
+// Ввод критериев поиска; тип кузова выбирается по коду словаря, сравнение идет по целым числам
+CarCriteria inputCriteria() {
+    CarCriteria criteria;
+    criteria.minPrice = inputInt("Минимальная цена", 0, 100000);
+    criteria.maxPrice = inputInt("Максимальная цена", criteria.minPrice, 100000);
+    criteria.maxMileage = inputInt("Максимальный пробег", 0, 500000);
+    criteria.minYear = inputInt("Минимальный год выпуска", 1990, 2024);
     
-    int dataSize = inputInt("Введите количество автомобилей для теста", 1000, 10000000);
+    StringDictionary& bodyTypes = bodyTypeDictionary();
+    cout << "Типы кузова: 0 - любой";
+    for (size_t i = 0; i < bodyTypes.size(); ++i) {
+        cout << ", " << (i + 1) << " - " << bodyTypes.name(static_cast<StringCode>(i));
+    }
+    cout << endl;
+    criteria.bodyTypeCode = inputInt("Тип кузова", 0, static_cast<int>(bodyTypes.size())) - 1;
+    return criteria;
+}
+
+// Потоковый просмотр файла, который не помещается в память: печатаются первые найденные и итоги
+int runStream(const string& path) {
+    try {
+        // Словари файла читаются сразу, чтобы в списке типов кузова были его значения
+        CarFileReader reader(path);
+        cout << "Укажите критерии для потокового просмотра " << path << " (" << reader.size() << " строк):" << endl;
+        CarCriteria criteria = inputCriteria();
+        
+        size_t shown = 0;
+        StreamScanStats stats = streamCarFile(reader, criteria, [&](const StreamBatch& batch) {
+            for (size_t i = 0; i < batch.cars.size() && shown < 3; ++i, ++shown) {
+                batch.cars[i].printInfo();
+            }
+        });
+        cout << "Строк в файле: " << stats.rows << ", найдено: " << stats.matches << endl;
+        cout << "Порций прочитано: " << stats.chunks << ", пропущено по зонным картам: " << stats.chunksSkipped
+             << ", прочитано " << stats.bytesRead / (1024 * 1024) << " МБ" << endl;
+        cout << "Время: " << fixed << setprecision(3) << stats.seconds << " секунд, из них ожидание чтения: "
+             << stats.ioWaitSeconds << " секунд" << endl;
+    } catch (const exception& e) {
+        cout << "Ошибка потокового просмотра: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Проверка, что два результата содержат одни и те же автомобили в одном порядке
+bool sameOrder(const vector<Car>& a, const vector<Car>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].price != b[i].price || a[i].mileage != b[i].mileage || a[i].year != b[i].year ||
+            a[i].brand != b[i].brand || a[i].bodyType != b[i].bodyType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Запуск:
+//   task2                   - сгенерировать данные
+//   task2 --save cars.bin   - сгенерировать и сохранить в двоичном формате
+//   task2 cars.bin          - отобразить сохраненный набор в память вместо генерации
+//   task2 cars.csv          - загрузить выгрузку brand,price,mileage,bodyType,year
+//   task2 --stream cars.bin - просмотреть двоичный файл порциями, не загружая его в память
+//   task2 --shards 4        - дополнительно разделить набор на 4 процесса-шарда и сравнить результаты
+//   task2 --stats-json      - напечатать статистику колоночного просмотра в JSON
+//   task2 --schedule static - распределение просмотра: static, morsel (по умолчанию) или affinity
+//   task2 --pin             - закрепить рабочие потоки пула за ядрами
+int main(int argc, char* argv[]) {
+    string loadPath, savePath;
+    int shardCount = 0;
+    bool printStatsJson = false;
+    ScanScheduling scheduling = ScanScheduling::Morsel;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            shardCount = max(1, atoi(argv[++i]));
+        } else if (arg == "--stats-json") {
+            printStatsJson = true;
+        } else if (arg == "--schedule" && i + 1 < argc) {
+            string mode = argv[++i];
+            scheduling = mode == "static" ? ScanScheduling::Static
+                       : mode == "affinity" ? ScanScheduling::Affinity : ScanScheduling::Morsel;
+        } else if (arg == "--pin") {
+            if (!ThreadPool::shared().pinWorkersToCores()) {
+                cout << "Не удалось закрепить потоки пула за ядрами" << endl;
+            }
+        } else if (arg == "--stream" && i + 1 < argc) {
+            return runStream(argv[++i]);
+        } else {
+            loadPath = arg;
+        }
+    }
     
-    // Генерация тестовых данных
-    vector<Car> cars = generateTestData(dataSize);
+    shared_ptr<const CarDataset> dataset;
+    auto prepareStart = chrono::high_resolution_clock::now();
+    if (!loadPath.empty()) {
+        try {
+            if (loadPath.size() > 4 && loadPath.compare(loadPath.size() - 4, 4, ".csv") == 0) {
+                CsvLoadStats csvStats;
+                dataset = loadCarsCsv(loadPath, true, ThreadPool::shared(), &csvStats);
+                cout << "Загружено из CSV: " << csvStats.rows << " строк, пропущено некорректных: "
+                     << csvStats.skippedLines << ", диапазонов: " << csvStats.ranges << endl;
+            } else {
+                // Данные читаются прямо из page cache, без разбора и копирования
+                dataset = CarDataset::mapFile(loadPath, true);
+            }
+        } catch (const exception& e) {
+            cout << "Ошибка загрузки: " << e.what() << endl;
+            return 1;
+        }
+    } else {
+        int dataSize = inputInt("Введите количество автомобилей для теста", 1000, 10000000);
+        
+        // Генерация тестовых данных; зерно печатается, чтобы запуск можно было повторить
+        random_device rd;
+        uint64_t seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+        vector<Car> cars = generateTestData(dataSize, seed);
+        
+        // Снимок данных создается один раз: вектор переносится без копирования,
+        // колонки, зонные карты и индексы строятся сразу
+        prepareStart = chrono::high_resolution_clock::now();
+        dataset = CarDataset::create(move(cars), true);
+    }
+    auto prepareEnd = chrono::high_resolution_clock::now();
+    cout << "Подготовка снимка данных" << (dataset->isMapped() ? " (отображение файла)" : "") << ": "
+         << fixed << setprecision(6) << chrono::duration<double>(prepareEnd - prepareStart).count()
+         << " секунд, индексы: " << dataset->getIndexMemoryBytes() / (1024 * 1024) << " МБ" << endl;
+    
+    if (!savePath.empty()) {
+        dataset->writeFile(savePath);
+        cout << "Набор сохранен в " << savePath << endl;
+    }
     
     cout << "Укажите критерии для поиска подходящих автомобилей:" << endl;
     
-    int minPrice = inputInt("Минимальная цена", 0, 100000);
-    int maxPrice = inputInt("Максимальная цена", minPrice, 100000);
-    int maxMileage = inputInt("Максимальный пробег", 0, 500000);
-    int minYear = inputInt("Минимальный год выпуска", 1990, 2024);
+    CarCriteria criteria = inputCriteria();
     
     int maxThreads = thread::hardware_concurrency();
     if (maxThreads == 0) maxThreads = 16; // Запасное значение
@@ -120,20 +214,25 @@ int main() {
     int numThreads = inputInt("Введите количество потоков для многопоточной обработки", 1, maxThreads * 2);
     
     cout << "ВЫБРАННЫЕ ПАРАМЕТРЫ" << endl;
-    cout << "Размер массива данных: " << dataSize << " автомобилей" << endl;
+    cout << "Размер массива данных: " << dataset->size() << " автомобилей" << endl;
     cout << "Критерии фильтрации:" << endl;
-    cout << "  - Диапазон цены: от " << minPrice << " до " << maxPrice << endl;
-    cout << "  - Максимальный пробег: " << maxMileage << " км" << endl;
-    cout << "  - Минимальный год выпуска: " << minYear << endl;
+    cout << "  - Диапазон цены: от " << criteria.minPrice << " до " << criteria.maxPrice << endl;
+    cout << "  - Максимальный пробег: " << criteria.maxMileage << " км" << endl;
+    cout << "  - Минимальный год выпуска: " << criteria.minYear << endl;
+    if (criteria.bodyTypeCode >= 0) {
+        cout << "  - Тип кузова: " << bodyTypeDictionary().name(static_cast<StringCode>(criteria.bodyTypeCode)) << endl;
+    }
     cout << "Количество потоков: " << numThreads << endl;
     
-    // Создание процессора для обработки автомобилей
-    CarProcessor processor(cars, minPrice, maxPrice, maxMileage, minYear);
+    // Создание процессора для обработки автомобилей; сначала без индексов, чтобы сравнить просмотры
+    CarProcessor processor(dataset);
+    processor.setUseIndexes(false);
+    processor.setScheduling(scheduling);
     
     // Однопоточная обработка
     cout << "ОДНОПОТОЧНАЯ ОБРАБОТКА" << endl;
     auto start = chrono::high_resolution_clock::now();
-    vector<Car> singleThreadResult = processor.processSingleThread();
+    vector<Car> singleThreadResult = processor.processSingleThread(criteria);
     auto end = chrono::high_resolution_clock::now();
     chrono::duration<double> singleThreadTime = end - start;
     
@@ -145,12 +244,293 @@ int main() {
     cout << "Используется потоков: " << numThreads << endl;
     
     start = chrono::high_resolution_clock::now();
-    vector<Car> multiThreadResult = processor.processMultiThread(numThreads);
+    vector<Car> multiThreadResult = processor.processMultiThread(criteria, numThreads);
     end = chrono::high_resolution_clock::now();
     chrono::duration<double> multiThreadTime = end - start;
     
     cout << "Найдено автомобилей: " << multiThreadResult.size() << endl;
     cout << "Время обработки: " << fixed << setprecision(6) << multiThreadTime.count() << " секунд" << endl;
+    cout << "Задержка передачи запроса в пул (" << processor.getPoolSize() << " потоков): "
+         << setprecision(1) << processor.getLastDispatchLatencyUs() << " мкс" << endl;
+    
+    // Колоночная обработка с SIMD-ядром
+    cout << "КОЛОНОЧНАЯ ОБРАБОТКА (" << filterKernelName(activeFilterKernel()) << ")" << endl;
+    processor.setScanMode(ScanMode::Columnar);
+    
+    start = chrono::high_resolution_clock::now();
+    CarSelection columnarResult = processor.selectMultiThread(criteria, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> columnarTime = end - start;
+    
+    cout << "Найдено автомобилей: " << columnarResult.size() << " (без копирования, только номера строк)" << endl;
+    cout << "Время обработки: " << fixed << setprecision(6) << columnarTime.count() << " секунд" << endl;
+    ScanStats scanStats = processor.getLastScanStats();
+    cout << "Блоков: " << scanStats.blocksTotal << ", пропущено по зонным картам: " << scanStats.blocksSkipped
+         << ", подошли целиком: " << scanStats.blocksFullMatch << endl;
+    cout << "Строк просмотрено: " << scanStats.rowsScanned << ", прочитано " << scanStats.bytesTouched / (1024 * 1024)
+         << " МБ, " << setprecision(2) << scanStats.gigabytesPerSecond() << " ГБ/с, "
+         << scanStats.rowsPerSecond() / 1e6 << " млн строк/с" << endl;
+    cout << "Задач: " << scanStats.taskSeconds.size() << ", участков: " << scanStats.morsels
+         << ", дисбаланс (самая долгая / средняя): "
+         << scanStats.taskImbalance() << ", склейка: " << setprecision(1) << scanStats.mergeSeconds * 1e6
+         << " мкс" << setprecision(6) << endl;
+    if (printStatsJson) {
+        cout << scanStats.toJson() << endl;
+    }
+    for (size_t i = 0; i < min<size_t>(3, columnarResult.size()); ++i) {
+        columnarResult[i].printInfo();
+    }
+    
+    // Один и тот же колоночный запрос при разных способах раздачи участков; лучшее из 5 прогонов
+    cout << "РАСПРЕДЕЛЕНИЕ ПРОСМОТРА" << endl;
+    const pair<ScanScheduling, const char*> schedulings[] = {
+        {ScanScheduling::Static, "по участку на задачу"},
+        {ScanScheduling::Morsel, "морсели из общей очереди"},
+        {ScanScheduling::Affinity, "морсели по потокам с кражей"}};
+    for (const auto& [mode, name] : schedulings) {
+        processor.setScheduling(mode);
+        double best = 1e9;
+        ScanStats modeStats;
+        for (int run = 0; run < 5; ++run) {
+            CarSelection modeResult = processor.selectMultiThread(criteria, numThreads);
+            ScanStats runStats = processor.getLastScanStats();
+            if (runStats.totalSeconds < best) {
+                best = runStats.totalSeconds;
+                modeStats = runStats;
+            }
+            if (modeResult.size() != columnarResult.size()) {
+                cout << "ВНИМАНИЕ: распределение \"" << name << "\" дало другой результат!" << endl;
+            }
+        }
+        cout << name << ": " << setprecision(6) << best << " секунд, участков: " << modeStats.morsels
+             << ", украдено: " << modeStats.morselsStolen << ", дисбаланс: " << setprecision(2)
+             << modeStats.taskImbalance() << setprecision(6) << endl;
+    }
+    processor.setScheduling(scheduling);
+    
+    // Асинхронный запрос: первые строки приходят раньше, чем заканчивается просмотр
+    cout << "АСИНХРОННЫЙ ЗАПРОС" << endl;
+    {
+        auto asyncStart = chrono::steady_clock::now();
+        atomic<long long> firstBatchNs{-1};
+        AsyncQueryOptions asyncOptions;
+        asyncOptions.onBatch = [&](const QueryBatch& batch) {
+            if (!batch.rows.empty() && firstBatchNs < 0) {
+                firstBatchNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - asyncStart).count();
+            }
+        };
+        QueryHandle query = processor.selectAsync(criteria, numThreads, asyncOptions);
+        CarSelection asyncResult = query.getResult();
+        double asyncSeconds = chrono::duration<double>(chrono::steady_clock::now() - asyncStart).count();
+        cout << "Статус: " << queryStatusName(query.getStatus()) << ", найдено: " << asyncResult.size()
+             << ", участков: " << query.getProgress().morselsTotal << endl;
+        cout << "Первые строки через " << setprecision(1) << firstBatchNs / 1e3 << " мкс, весь результат через "
+             << asyncSeconds * 1e6 << " мкс" << setprecision(6) << endl;
+        if (asyncResult.getRows() != columnarResult.getRows()) {
+            cout << "ВНИМАНИЕ: асинхронный запрос дал другой результат!" << endl;
+        }
+        
+        // Запрос со сроком в 10% от полного времени останавливается и отдает завершенные участки
+        AsyncQueryOptions deadlineOptions;
+        deadlineOptions.deadline = chrono::steady_clock::now() +
+                                   chrono::nanoseconds(static_cast<long long>(asyncSeconds * 1e8));
+        QueryHandle limited = processor.selectAsync(criteria, numThreads, deadlineOptions);
+        CarSelection partial = limited.getResult();
+        QueryProgress progress = limited.getProgress();
+        cout << "Со сроком: " << queryStatusName(limited.getStatus()) << ", готово участков " << progress.morselsDone
+             << " из " << progress.morselsTotal << ", найдено " << partial.size() << endl;
+        
+        // Брошенный запрос отменяется сразу и почти не занимает ядра
+        QueryHandle abandoned = processor.selectAsync(criteria, numThreads);
+        abandoned.cancel();
+        cout << "Отмененный: " << queryStatusName(abandoned.wait()) << ", готово участков "
+             << abandoned.getProgress().morselsDone << " из " << abandoned.getProgress().morselsTotal << endl;
+    }
+    
+    // Сжатые колонки: тот же запрос по упакованным данным
+    cout << "СЖАТЫЕ КОЛОНКИ" << endl;
+    {
+        auto packStart = chrono::steady_clock::now();
+        CompressedCarTable compressed(*dataset);
+        double packSeconds = chrono::duration<double>(chrono::steady_clock::now() - packStart).count();
+        cout << "Колонки: " << compressed.uncompressedBytes() / 1024 << " КБ, сжатые: " << compressed.memoryBytes() / 1024
+             << " КБ (" << setprecision(1) << 100.0 * compressed.memoryBytes() / max<size_t>(1, compressed.uncompressedBytes())
+             << "%), упаковка " << setprecision(6) << packSeconds << " секунд" << endl;
+        
+        ScanStats packedStats;
+        vector<RowId> packedRows = compressed.select(criteria, numThreads, &packedStats);
+        cout << "Найдено автомобилей: " << packedRows.size() << ", время: " << packedStats.totalSeconds << " секунд, прочитано "
+             << packedStats.bytesTouched / 1024 << " КБ против " << scanStats.bytesTouched / 1024 << " КБ без сжатия" << endl;
+        if (packedRows != columnarResult.getRows()) {
+            cout << "ВНИМАНИЕ: просмотр сжатых колонок дал другой результат!" << endl;
+        }
+    }
+    
+    // Пакет запросов: 16 ценовых диапазонов одним проходом против 16 отдельных просмотров
+    cout << "ПАКЕТ ЗАПРОСОВ" << endl;
+    vector<CarCriteria> batch;
+    for (int i = 0; i < 16; ++i) {
+        CarCriteria band = criteria;
+        band.minPrice = criteria.minPrice + (criteria.maxPrice - criteria.minPrice) * i / 16;
+        batch.push_back(band);
+    }
+    
+    start = chrono::high_resolution_clock::now();
+    vector<CarSelection> batchResults = processor.selectBatch(batch, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> batchTime = end - start;
+    
+    start = chrono::high_resolution_clock::now();
+    vector<CarSelection> separateResults;
+    for (const auto& bandCriteria : batch) {
+        separateResults.push_back(move(processor.selectBatch({bandCriteria}, numThreads)[0]));
+    }
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> separateTime = end - start;
+    
+    cout << "Запросов в пакете: " << batch.size() << ", найдено по первому: " << batchResults[0].size() << endl;
+    cout << "Один проход: " << batchTime.count() << " секунд, отдельные проходы: " << separateTime.count() << " секунд" << endl;
+    
+    // Поиск через вторичные индексы
+    cout << "ИНДЕКСНЫЙ ПОИСК" << endl;
+    processor.setUseIndexes(true);
+    
+    const char* pathNames[] = {"полный просмотр", "индекс по цене", "индекс по пробегу", "индекс по году"};
+    QueryPlan plan = processor.planQuery(criteria);
+    cout << "План запроса: " << pathNames[static_cast<int>(plan.path)] << ", кандидатов: " << plan.candidates << endl;
+    
+    start = chrono::high_resolution_clock::now();
+    CarSelection indexedResult = processor.selectMultiThread(criteria, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> indexedTime = end - start;
+    
+    cout << "Найдено автомобилей: " << indexedResult.size() << endl;
+    cout << "Время обработки: " << indexedTime.count() << " секунд" << endl;
+    
+    // Агрегаты считаются в просмотре без копирования подходящих автомобилей
+    cout << "АГРЕГАТЫ" << endl;
+    start = chrono::high_resolution_clock::now();
+    CarAggregate summary = processor.aggregate(criteria, numThreads);
+    vector<CarGroup> byBodyType = processor.aggregateBy(criteria, GroupBy::BodyType, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> aggregateTime = end - start;
+    
+    cout << "Количество: " << summary.count << endl;
+    if (summary.count > 0) {
+        cout << "Цена: средняя " << setprecision(0) << summary.averagePrice() << ", от " << summary.minPrice
+             << " до " << summary.maxPrice << endl;
+        cout << "Пробег: средний " << summary.averageMileage() << ", от " << summary.minMileage
+             << " до " << summary.maxMileage << endl;
+    }
+    for (const auto& group : byBodyType) {
+        cout << "  " << bodyTypeDictionary().name(static_cast<StringCode>(group.key)) << ": " << group.aggregate.count
+             << " шт., средняя цена " << group.aggregate.averagePrice() << endl;
+    }
+    cout << "Время обработки: " << setprecision(6) << aggregateTime.count() << " секунд" << endl;
+    
+    // Те же критерии, собранные из шаблонных условий; тип кузова - диапазон кодов из одного значения или все коды
+    cout << "СОСТАВНОЕ УСЛОВИЕ" << endl;
+    Range<CarField::BodyType> bodyTypeRange;
+    if (criteria.bodyTypeCode >= 0) {
+        bodyTypeRange = {criteria.bodyTypeCode, criteria.bodyTypeCode};
+    }
+    start = chrono::high_resolution_clock::now();
+    CarSelection predicateResult = processor.selectWhere(criteriaPredicate(criteria) & bodyTypeRange, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> predicateTime = end - start;
+    
+    cout << "Найдено автомобилей: " << predicateResult.size() << endl;
+    cout << "Время обработки: " << predicateTime.count() << " секунд" << endl;
+    
+    // Битовые карты: карта критериев и отдельная карта "год >= 2015" комбинируются пословно
+    cout << "БИТОВЫЕ КАРТЫ" << endl;
+    start = chrono::high_resolution_clock::now();
+    SelectionBitmap criteriaBitmap = processor.selectBitmap(criteria, numThreads);
+    SelectionBitmap recentBitmap = processor.selectBitmapWhere(Range<CarField::Year>{2015, INT_MAX}, numThreads);
+    SelectionBitmap recentMatches = criteriaBitmap & recentBitmap;
+    CarSelection bitmapResult = processor.selectFromBitmap(criteriaBitmap, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> bitmapTime = end - start;
+    
+    cout << "Подходят: " << criteriaBitmap.count() << ", из них не старше 2015 года: " << recentMatches.count()
+         << " (карта " << criteriaBitmap.memoryBytes() / 1024 << " КБ)" << endl;
+    cout << "Время обработки: " << bitmapTime.count() << " секунд" << endl;
+    
+    // Самые дешевые подходящие автомобили без сортировки всего результата
+    cout << "ТОП-5 ПО ЦЕНЕ" << endl;
+    start = chrono::high_resolution_clock::now();
+    CarSelection cheapest = processor.selectTopK(criteria, {SortField::Price, false}, 5, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> topKTime = end - start;
+    
+    for (size_t i = 0; i < cheapest.size(); ++i) {
+        cheapest[i].printInfo();
+    }
+    cout << "Время обработки: " << topKTime.count() << " секунд" << endl;
+    
+    // Повторный запрос через кэш результатов: первый раз промах, затем попадание
+    cout << "КЭШ ЗАПРОСОВ" << endl;
+    QueryCache cache;
+    cache.select(processor, criteria, numThreads);
+    start = chrono::high_resolution_clock::now();
+    shared_ptr<const CarSelection> cachedResult = cache.select(processor, criteria, numThreads);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> cachedTime = end - start;
+    
+    QueryCacheStats cacheStats = cache.getStats();
+    cout << "Попаданий: " << cacheStats.hits << ", промахов: " << cacheStats.misses
+         << ", занято: " << cacheStats.bytes / 1024 << " КБ" << endl;
+    cout << "Время повторного запроса: " << setprecision(2) << cachedTime.count() * 1e6 << " мкс" << setprecision(6) << endl;
+    
+    // Поток изменений: постоянный запрос обновляется по каждой измененной строке
+    cout << "ПОТОК ИЗМЕНЕНИЙ" << endl;
+    LiveCarStore store(*dataset);
+    StandingQueryId standing = store.registerQuery(criteria);
+    vector<Car> feed = generateCars(3000, 1);
+    mt19937 feedRng(1);
+    
+    start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < feed.size(); ++i) {
+        RowId row = feedRng() % store.size();
+        if (i % 3 == 0) {
+            store.append(feed[i]);
+        } else if (store.isLive(row)) {
+            if (i % 3 == 1) store.update(row, feed[i]);
+            else store.remove(row);
+        }
+    }
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double> feedTime = end - start;
+    
+    CarProcessor liveProcessor(store.snapshot());
+    size_t rescanCount = liveProcessor.selectMultiThread(criteria, numThreads).size();
+    cout << "Изменений: " << feed.size() << ", в постоянном запросе: " << store.getQueryCount(standing)
+         << ", повторный просмотр: " << rescanCount << endl;
+    cout << "Время на изменение: " << setprecision(2) << feedTime.count() * 1e6 / feed.size() << " мкс" << setprecision(6) << endl;
+    
+    // Рассылка запроса по процессам-шардам
+    size_t shardedCount = columnarResult.size();
+    vector<RowId> shardedRows = columnarResult.getRows();
+    if (shardCount > 0) {
+        cout << "ШАРДЫ" << endl;
+        string prefix = (filesystem::temp_directory_path() / ("task2_shard_" + to_string(getpid()))).string();
+        vector<ShardInfo> shards;
+        try {
+            shards = writeShards(*dataset, shardCount, prefix);
+            ShardCoordinator coordinator(shards);
+            start = chrono::high_resolution_clock::now();
+            shardedCount = coordinator.count(criteria);
+            shardedRows = coordinator.selectRows(criteria);
+            end = chrono::high_resolution_clock::now();
+            cout << "Шардов: " << coordinator.getShardCount() << ", найдено: " << shardedCount << endl;
+            cout << "Время (количество и строки): " << chrono::duration<double>(end - start).count() << " секунд" << endl;
+        } catch (const exception& e) {
+            cout << "Ошибка шардов: " << e.what() << endl;
+        }
+        for (const auto& shard : shards) {
+            filesystem::remove(shard.path);
+        }
+    }
     
     // Проверка корректности результатов
     cout << "ПРОВЕРКА РЕЗУЛЬТАТОВ" << endl;
@@ -162,10 +542,52 @@ int main() {
         cout << "Количество результатов совпадает: " 
              << singleThreadResult.size() << " автомобилей" << endl;
     }
+    if (sameOrder(singleThreadResult, multiThreadResult)) {
+        cout << "Порядок результатов совпадает с однопоточным режимом" << endl;
+    } else {
+        cout << "ВНИМАНИЕ: Порядок результатов отличается!" << endl;
+    }
+    if (columnarResult.size() != singleThreadResult.size()) {
+        cout << "ВНИМАНИЕ: Колоночный режим нашел " << columnarResult.size() << " автомобилей!" << endl;
+    }
+    if (batchResults[0].getRows() != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Пакетный запрос вернул другие строки!" << endl;
+    }
+    if (indexedResult.getRows() != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Индексный поиск вернул другие строки!" << endl;
+    }
+    if (predicateResult.getRows() != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Составное условие вернуло другие строки!" << endl;
+    }
+    if (shardedCount != columnarResult.size() || shardedRows != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Шарды вернули другие строки!" << endl;
+    }
+    if (store.getQueryCount(standing) != rescanCount) {
+        cout << "ВНИМАНИЕ: Постоянный запрос разошелся с повторным просмотром!" << endl;
+    }
+    if (cachedResult->getRows() != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Кэш вернул другие строки!" << endl;
+    }
+    if (bitmapResult.getRows() != columnarResult.getRows()) {
+        cout << "ВНИМАНИЕ: Битовая карта дала другие строки!" << endl;
+    }
+    if (!cheapest.empty() && cheapest[0].price != summary.minPrice) {
+        cout << "ВНИМАНИЕ: Самая низкая цена в топе не совпадает с агрегатом!" << endl;
+    }
+    if (summary.count != columnarResult.size()) {
+        cout << "ВНИМАНИЕ: Агрегат насчитал " << summary.count << " автомобилей!" << endl;
+    }
     
     // Сравнение времени выполнения
     cout << "СРАВНЕНИЕ ПРОИЗВОДИТЕЛЬНОСТИ" << endl;
     cout << fixed << setprecision(6);
     cout << "Однопоточная обработка: " << singleThreadTime.count() << " сек" << endl;
     cout << "Многопоточная обработка: " << multiThreadTime.count() << " сек" << endl;
+    cout << "Колоночная обработка: " << columnarTime.count() << " сек" << endl;
+    cout << "Индексный поиск: " << indexedTime.count() << " сек" << endl;
+    cout << "Составное условие: " << predicateTime.count() << " сек" << endl;
+    cout << "Битовые карты (две карты и извлечение строк): " << bitmapTime.count() << " сек" << endl;
+    cout << "Агрегаты (два запроса): " << aggregateTime.count() << " сек" << endl;
+    cout << "Топ по цене: " << topKTime.count() << " сек" << endl;
+    cout << "Повторный запрос из кэша: " << cachedTime.count() << " сек" << endl;
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть " + path + ": " + strerror(errno));
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw runtime_error("Не удалось получить размер " + path + ": " + strerror(err));
+    }
+    length = static_cast<size_t>(st.st_size);
+    
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw runtime_error("Не удалось отобразить " + path + ": " + strerror(err));
+        }
+        data = static_cast<const char*>(mapped);
+    }
+    
+    // Отображение остается действительным и после закрытия дескриптора
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), length);
+    }
+}
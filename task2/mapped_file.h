@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// Файл, отображенный в память только для чтения (mmap).
+// Страницы подгружаются ядром по мере обращения и разделяются через page cache
+// между всеми процессами, отобразившими тот же файл.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    
+public:
+    // Бросает runtime_error, если файл не удалось открыть или отобразить
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const char* getData() const { return data; }
+    size_t size() const { return length; }
+};
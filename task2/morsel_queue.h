@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// Очередь морселей - небольших участков просмотра, которые потоки разбирают по ходу работы.
+// Номера [0, count) делятся на rangeCount смежных диапазонов. Поток берет морсели своего
+// (домашнего) диапазона по возрастанию, а когда тот кончился, забирает оставшиеся из чужих.
+// С одним диапазоном это общая очередь: следующий морсель достается первому освободившемуся потоку.
+class MorselQueue {
+private:
+    // Каждый курсор в своей строке кэша, чтобы потоки разных диапазонов не мешали друг другу
+    struct alignas(64) Range {
+        atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    vector<Range> ranges;
+
+public:
+    MorselQueue(size_t count, size_t rangeCount) : ranges(rangeCount ? rangeCount : 1) {
+        size_t perRange = (count + ranges.size() - 1) / ranges.size();
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            ranges[r].next.store(min(r * perRange, count), memory_order_relaxed);
+            ranges[r].end = min((r + 1) * perRange, count);
+        }
+    }
+
+    MorselQueue(const MorselQueue&) = delete;
+    MorselQueue& operator=(const MorselQueue&) = delete;
+
+    // Следующий морсель для потока с домашним диапазоном home % rangeCount.
+    // stolen - морсель взят из чужого диапазона; false - морсели кончились.
+    // Порядок памяти ослаблен: результаты публикует завершение parallelFor.
+    bool pop(size_t home, size_t& morsel, bool& stolen) {
+        size_t rangeCount = ranges.size();
+        for (size_t k = 0; k < rangeCount; ++k) {
+            Range& range = ranges[(home + k) % rangeCount];
+            if (range.next.load(memory_order_relaxed) >= range.end) continue;
+
+            size_t m = range.next.fetch_add(1, memory_order_relaxed);
+            if (m < range.end) {
+                morsel = m;
+                stolen = k != 0;
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,109 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// Приблизительные накладные расходы одной записи: узел списка, элемент хеш-таблицы, CarSelection
+static constexpr size_t kEntryOverheadBytes = 160;
+
+CarCriteria normalizeCriteria(const CarCriteria& c, const ZoneMap& totals) {
+    CarCriteria n = c;
+    n.minPrice = max(c.minPrice, totals.minPrice);
+    n.maxPrice = min(c.maxPrice, totals.maxPrice);
+    n.maxMileage = min(c.maxMileage, totals.maxMileage);
+    n.minYear = max(c.minYear, totals.minYear);
+    n.brandCode = max(c.brandCode, -1);
+    n.bodyTypeCode = max(c.bodyTypeCode, -1);
+    
+    if (n.minPrice > n.maxPrice || n.maxMileage < totals.minMileage || n.minYear > totals.maxYear) {
+        return CarCriteria{1, 0, -1, INT_MAX, -1, -1};
+    }
+    return n;
+}
+
+bool QueryCache::Key::operator==(const Key& other) const {
+    return version == other.version &&
+           criteria.minPrice == other.criteria.minPrice && criteria.maxPrice == other.criteria.maxPrice &&
+           criteria.maxMileage == other.criteria.maxMileage && criteria.minYear == other.criteria.minYear &&
+           criteria.brandCode == other.criteria.brandCode && criteria.bodyTypeCode == other.criteria.bodyTypeCode;
+}
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const {
+    uint64_t h = key.version;
+    int fields[] = {key.criteria.minPrice, key.criteria.maxPrice, key.criteria.maxMileage,
+                    key.criteria.minYear, key.criteria.brandCode, key.criteria.bodyTypeCode};
+    for (int field : fields) {
+        h = (h ^ static_cast<uint32_t>(field)) * 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+QueryCache::QueryCache(size_t maxBytes) : maxBytes(maxBytes) {}
+
+void QueryCache::evictToFit() {
+    while (stats.bytes > maxBytes && !entries.empty()) {
+        Entry& victim = entries.back();
+        stats.bytes -= victim.bytes;
+        stats.evictions++;
+        index.erase(victim.key);
+        entries.pop_back();
+    }
+}
+
+shared_ptr<const CarSelection> QueryCache::select(const CarProcessor& processor, const CarCriteria& criteria, int numThreads) {
+    const CarDataset& data = *processor.getDataset();
+    Key key{data.getVersion(), normalizeCriteria(criteria, data.getTotals())};
+    
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            stats.hits++;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->result;
+        }
+        stats.misses++;
+    }
+    
+    auto result = make_shared<const CarSelection>(processor.selectMultiThread(key.criteria, numThreads));
+    size_t bytes = result->size() * sizeof(RowId) + kEntryOverheadBytes;
+    if (bytes > maxBytes) return result;   // Слишком большой результат не вытесняет весь кэш
+    
+    lock_guard<mutex> lock(cacheMutex);
+    if (index.count(key) == 0) {
+        // Другой поток мог сохранить тот же запрос, пока этот выполнял просмотр
+        entries.push_front({key, result, bytes});
+        index.emplace(key, entries.begin());
+        stats.bytes += bytes;
+        evictToFit();
+    }
+    return result;
+}
+
+void QueryCache::retainVersion(uint64_t version) {
+    lock_guard<mutex> lock(cacheMutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->key.version != version) {
+            stats.bytes -= it->bytes;
+            index.erase(it->key);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QueryCache::clear() {
+    lock_guard<mutex> lock(cacheMutex);
+    entries.clear();
+    index.clear();
+    stats.bytes = 0;
+}
+
+QueryCacheStats QueryCache::getStats() const {
+    lock_guard<mutex> lock(cacheMutex);
+    QueryCacheStats result = stats;
+    result.entries = entries.size();
+    return result;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "car.h"
+#include "car_selection.h"
+#include "car_processor.h"
+
+using namespace std;
+
+// Счетчики кэша для подбора его размера
+struct QueryCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;     // Оценка памяти, занятой результатами
+};
+
+// Критерии, приведенные к границам данных снимка: запросы, которые отбирают одни и те же строки
+// по числовым полям (например, minPrice = 0 и minPrice = минимальная цена снимка), дают один ключ.
+// Все заведомо пустые запросы сводятся к одному ключу.
+CarCriteria normalizeCriteria(const CarCriteria& criteria, const ZoneMap& totals);
+
+// Кэш результатов запросов перед CarProcessor с вытеснением давно не использованных (LRU).
+// Ключ - версия снимка и нормализованные критерии: после замены снимка старые записи
+// больше не находятся и постепенно вытесняются, поэтому устаревший результат не вернется.
+// Результаты отдаются через shared_ptr, попадание не копирует номера строк.
+class QueryCache {
+private:
+    struct Key {
+        uint64_t version;
+        CarCriteria criteria;
+        
+        bool operator==(const Key& other) const;
+    };
+    
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    
+    struct Entry {
+        Key key;
+        shared_ptr<const CarSelection> result;
+        size_t bytes;
+    };
+    
+    size_t maxBytes;
+    list<Entry> entries;                                            // В начале - последние использованные
+    unordered_map<Key, list<Entry>::iterator, KeyHash> index;
+    QueryCacheStats stats;
+    mutable mutex cacheMutex;
+    
+    void evictToFit();
+    
+public:
+    explicit QueryCache(size_t maxBytes = 64 * 1024 * 1024);
+    
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+    
+    // Результат из кэша или выполнение processor.selectMultiThread с сохранением результата.
+    // Запрос выполняется без блокировки кэша, так что промахи разных потоков не ждут друг друга.
+    shared_ptr<const CarSelection> select(const CarProcessor& processor, const CarCriteria& criteria, int numThreads);
+    
+    // Удаляет записи всех версий, кроме указанной (например, сразу после публикации нового снимка)
+    void retainVersion(uint64_t version);
+    
+    void clear();
+    
+    QueryCacheStats getStats() const;
+};
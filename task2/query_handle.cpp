@@ -0,0 +1,99 @@
+#include "query_handle.h"
+
+using namespace std;
+
+void AsyncQueryState::fail(exception_ptr e) {
+    {
+        lock_guard<mutex> lock(resultMutex);
+        if (!error) error = e;
+    }
+    stopRequested = true;
+}
+
+void AsyncQueryState::finish(CarSelection selection) {
+    {
+        lock_guard<mutex> lock(resultMutex);
+        result = move(selection);
+        // Если все участки успели завершиться, отмена или срок уже ничего не изменили
+        if (error) {
+            status = QueryStatus::Failed;
+        } else if (morselsDone.load() == morselsTotal) {
+            status = QueryStatus::Completed;
+        } else if (deadlineExceeded.load()) {
+            status = QueryStatus::DeadlineExceeded;
+        } else {
+            status = QueryStatus::Cancelled;
+        }
+    }
+    resultCv.notify_all();
+}
+
+QueryHandle::QueryHandle(shared_ptr<AsyncQueryState> state, future<void> driver)
+    : state(move(state)), driver(move(driver)) {}
+
+QueryHandle::~QueryHandle() {
+    cancel();
+    if (driver.valid()) {
+        driver.wait();
+    }
+}
+
+QueryHandle& QueryHandle::operator=(QueryHandle&& other) {
+    if (this != &other) {
+        cancel();
+        if (driver.valid()) driver.wait();
+        state = move(other.state);
+        driver = move(other.driver);
+    }
+    return *this;
+}
+
+void QueryHandle::cancel() {
+    if (state) {
+        state->stopRequested = true;
+    }
+}
+
+QueryStatus QueryHandle::getStatus() const {
+    if (!state) return QueryStatus::Cancelled;
+    lock_guard<mutex> lock(state->resultMutex);
+    return state->status;
+}
+
+QueryProgress QueryHandle::getProgress() const {
+    if (!state) return {};
+    return {state->morselsDone.load(), state->morselsTotal, state->rowsMatched.load()};
+}
+
+QueryStatus QueryHandle::wait() const {
+    if (!state) return QueryStatus::Cancelled;
+    unique_lock<mutex> lock(state->resultMutex);
+    state->resultCv.wait(lock, [&] { return state->status != QueryStatus::Running; });
+    return state->status;
+}
+
+bool QueryHandle::waitFor(chrono::steady_clock::duration timeout) const {
+    if (!state) return true;
+    unique_lock<mutex> lock(state->resultMutex);
+    return state->resultCv.wait_for(lock, timeout, [&] { return state->status != QueryStatus::Running; });
+}
+
+CarSelection QueryHandle::getResult() const {
+    if (!state) return {};
+    wait();
+    lock_guard<mutex> lock(state->resultMutex);
+    if (state->error) {
+        rethrow_exception(state->error);
+    }
+    return state->result;
+}
+
+const char* queryStatusName(QueryStatus status) {
+    switch (status) {
+        case QueryStatus::Running: return "выполняется";
+        case QueryStatus::Completed: return "завершен";
+        case QueryStatus::Cancelled: return "отменен";
+        case QueryStatus::DeadlineExceeded: return "превышен срок";
+        default: return "ошибка";
+    }
+}
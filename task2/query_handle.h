@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include "car.h"
+#include "car_selection.h"
+
+using namespace std;
+
+// Состояние асинхронного запроса
+enum class QueryStatus {
+    Running,
+    Completed,
+    Cancelled,           // Остановлен вызовом cancel() или удалением дескриптора
+    DeadlineExceeded,    // Не успел к сроку
+    Failed               // Исключение при просмотре или в обработчике порций
+};
+
+// Подходящие строки одного завершенного участка таблицы [firstRow, endRow).
+// Участки завершаются в произвольном порядке; внутри порции строки идут по возрастанию.
+struct QueryBatch {
+    size_t morsel = 0;           // Номер участка: порядок участков совпадает с порядком строк
+    size_t firstRow = 0;
+    size_t endRow = 0;
+    span<const RowId> rows;      // Действительны только на время вызова обработчика
+};
+
+struct QueryProgress {
+    size_t morselsDone = 0;
+    size_t morselsTotal = 0;
+    size_t rowsMatched = 0;      // Найдено в завершенных участках
+
+    double fraction() const { return morselsTotal ? static_cast<double>(morselsDone) / morselsTotal : 1.0; }
+};
+
+struct AsyncQueryOptions {
+    // Срок, после которого запрос останавливается со статусом DeadlineExceeded
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+
+    // Вызывается для каждого завершенного участка из рабочих потоков пула, но не одновременно.
+    // Пустые участки тоже передаются: по ним удобно обновлять прогресс.
+    function<void(const QueryBatch&)> onBatch;
+};
+
+// Общее состояние запроса: его пишет просмотр, читает дескриптор
+struct AsyncQueryState {
+    atomic<bool> stopRequested{false};   // Проверяется перед каждым блоком
+    atomic<bool> deadlineExceeded{false};
+    atomic<size_t> morselsDone{0};
+    atomic<size_t> rowsMatched{0};
+    size_t morselsTotal = 0;
+
+    mutex resultMutex;
+    condition_variable resultCv;
+    QueryStatus status = QueryStatus::Running;
+    exception_ptr error;
+    CarSelection result;
+
+    // Первое исключение останавливает остальные участки
+    void fail(exception_ptr e);
+
+    // Публикует результат и будит ожидающих
+    void finish(CarSelection selection);
+};
+
+// Дескриптор асинхронного запроса (CarProcessor::selectAsync).
+// Удаление дескриптора отменяет запрос и дожидается остановки просмотра. Запрос держит свой
+// снимок данных, поэтому процессор можно удалить раньше дескриптора; пул потоков - нельзя.
+class QueryHandle {
+private:
+    shared_ptr<AsyncQueryState> state;
+    future<void> driver;                 // Поток, который раздает участки пулу
+
+public:
+    QueryHandle() = default;
+    QueryHandle(shared_ptr<AsyncQueryState> state, future<void> driver);
+    ~QueryHandle();
+
+    QueryHandle(QueryHandle&&) = default;
+    QueryHandle& operator=(QueryHandle&& other);
+    QueryHandle(const QueryHandle&) = delete;
+    QueryHandle& operator=(const QueryHandle&) = delete;
+
+    // Просит остановить просмотр: участки, которые уже начаты, бросаются на ближайшей границе блока
+    void cancel();
+
+    QueryStatus getStatus() const;
+    bool isDone() const { return getStatus() != QueryStatus::Running; }
+    QueryProgress getProgress() const;
+
+    // Ждет завершения; waitFor возвращает false, если запрос еще идет
+    QueryStatus wait() const;
+    bool waitFor(chrono::steady_clock::duration timeout) const;
+
+    // Ждет завершения и возвращает строки всех завершенных участков в порядке таблицы:
+    // после Completed это полный результат, после отмены или срока - частичный.
+    // После Failed бросает исключение просмотра.
+    CarSelection getResult() const;
+};
+
+// Имя состояния для вывода
+const char* queryStatusName(QueryStatus status);
@@ -0,0 +1,90 @@
+#include "selection_bitmap.h"
+#include <bit>
+#include <stdexcept>
+
+using namespace std;
+
+SelectionBitmap::SelectionBitmap(size_t rowCount) : rowCount(rowCount), words((rowCount + 63) / 64, 0) {}
+
+void SelectionBitmap::clearTail() {
+    if (rowCount % 64 != 0) {
+        words.back() &= (uint64_t(1) << (rowCount % 64)) - 1;
+    }
+}
+
+void SelectionBitmap::resize(size_t newRowCount) {
+    rowCount = newRowCount;
+    words.resize((newRowCount + 63) / 64, 0);
+    clearTail();
+}
+
+void SelectionBitmap::setRange(size_t start, size_t end) {
+    if (start >= end) return;
+    size_t first = start / 64, last = (end - 1) / 64;
+    uint64_t head = ~uint64_t(0) << (start % 64);
+    uint64_t tail = ~uint64_t(0) >> (63 - (end - 1) % 64);
+    if (first == last) {
+        words[first] |= head & tail;
+        return;
+    }
+    words[first] |= head;
+    for (size_t w = first + 1; w < last; ++w) {
+        words[w] = ~uint64_t(0);
+    }
+    words[last] |= tail;
+}
+
+size_t SelectionBitmap::count() const {
+    size_t total = 0;
+    for (uint64_t word : words) {
+        total += popcount(word);
+    }
+    return total;
+}
+
+// Пословные циклы без зависимостей между итерациями компилятор векторизует сам
+SelectionBitmap& SelectionBitmap::operator&=(const SelectionBitmap& other) {
+    if (other.rowCount != rowCount) throw invalid_argument("SelectionBitmap: разный размер карт");
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] &= other.words[w];
+    }
+    return *this;
+}
+
+SelectionBitmap& SelectionBitmap::operator|=(const SelectionBitmap& other) {
+    if (other.rowCount != rowCount) throw invalid_argument("SelectionBitmap: разный размер карт");
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] |= other.words[w];
+    }
+    return *this;
+}
+
+SelectionBitmap& SelectionBitmap::andNot(const SelectionBitmap& other) {
+    if (other.rowCount != rowCount) throw invalid_argument("SelectionBitmap: разный размер карт");
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w] &= ~other.words[w];
+    }
+    return *this;
+}
+
+SelectionBitmap SelectionBitmap::operator~() const {
+    SelectionBitmap result(*this);
+    for (uint64_t& word : result.words) {
+        word = ~word;
+    }
+    result.clearTail();
+    return result;
+}
+
+vector<RowId> SelectionBitmap::toRows() const {
+    vector<RowId> rows;
+    rows.reserve(count());
+    for (size_t w = 0; w < words.size(); ++w) {
+        uint64_t bits = words[w];
+        while (bits) {
+            rows.push_back(static_cast<RowId>(w * 64 + countr_zero(bits)));
+            bits &= bits - 1;
+        }
+    }
+    return rows;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "car.h"
+
+using namespace std;
+
+// Выборка в виде битовой карты: бит строки r - бит r % 64 слова r / 64.
+// Карты одного снимка комбинируются пословно, число строк считается через popcount,
+// а номера строк извлекаются только в конце.
+class SelectionBitmap {
+private:
+    size_t rowCount = 0;
+    vector<uint64_t> words;
+    
+    // Обнуляет биты за последней строкой (после инверсии)
+    void clearTail();
+    
+public:
+    SelectionBitmap() = default;
+    
+    // Пустая выборка (все биты сброшены) для rowCount строк
+    explicit SelectionBitmap(size_t rowCount);
+    
+    size_t size() const { return rowCount; }
+    size_t wordCount() const { return words.size(); }
+    uint64_t* data() { return words.data(); }
+    const uint64_t* data() const { return words.data(); }
+    
+    bool test(RowId row) const { return (words[row / 64] >> (row % 64)) & 1; }
+    void set(RowId row) { words[row / 64] |= uint64_t(1) << (row % 64); }
+    void reset(RowId row) { words[row / 64] &= ~(uint64_t(1) << (row % 64)); }
+    
+    // Меняет число строк; новые строки не выбраны
+    void resize(size_t newRowCount);
+    
+    // Устанавливает биты строк [start, end)
+    void setRange(size_t start, size_t end);
+    
+    // Число выбранных строк
+    size_t count() const;
+    
+    // Операции над картами одинакового размера (иначе invalid_argument)
+    SelectionBitmap& operator&=(const SelectionBitmap& other);
+    SelectionBitmap& operator|=(const SelectionBitmap& other);
+    SelectionBitmap& andNot(const SelectionBitmap& other);
+    SelectionBitmap operator~() const;
+    
+    // Номера выбранных строк по возрастанию
+    vector<RowId> toRows() const;
+    
+    size_t memoryBytes() const { return words.size() * sizeof(uint64_t); }
+};
+
+inline SelectionBitmap operator&(SelectionBitmap a, const SelectionBitmap& b) { return a &= b; }
+inline SelectionBitmap operator|(SelectionBitmap a, const SelectionBitmap& b) { return a |= b; }
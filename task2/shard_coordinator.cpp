@@ -0,0 +1,326 @@
+#include "shard_coordinator.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <thread>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Вид запроса к шарду
+enum class ShardRequestKind : uint32_t {
+    Count = 1,
+    Rows = 2,
+    TopK = 3
+};
+
+// Запрос передается одной структурой фиксированного размера
+struct ShardRequest {
+    ShardRequestKind kind;
+    CarCriteria criteria;
+    SortOrder order;
+    uint64_t limit;
+};
+
+// Ответ: заголовок, затем bytes байт данных (или текст ошибки при status != 0)
+struct ShardResponseHeader {
+    int64_t status;
+    uint64_t bytes;
+};
+
+// Элемент топа: ключ сортировки и номер строки исходного набора
+struct ShardTopEntry {
+    long long key;
+    RowId row;
+};
+
+// MSG_NOSIGNAL: запись в сокет завершившегося шарда дает EPIPE в этом вызове, а не SIGPIPE процессу
+static void writeAll(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw runtime_error(string("Ошибка передачи шарду: ") + strerror(errno));
+        p += n;
+        bytes -= n;
+    }
+}
+
+// false - соединение закрыто до начала сообщения.
+// Если данные не приходят до deadline, бросает runtime_error: зависший шард не должен блокировать координатор
+static bool readAll(int fd, void* data, size_t bytes,
+                    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max()) {
+    char* p = static_cast<char*>(data);
+    size_t done = 0;
+    while (done < bytes) {
+        if (deadline != chrono::steady_clock::time_point::max()) {
+            auto left = chrono::ceil<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+            pollfd ready{fd, POLLIN, 0};
+            int polled = left.count() > 0 ? poll(&ready, 1, static_cast<int>(min<long long>(left.count(), INT_MAX))) : 0;
+            if (polled < 0 && errno == EINTR) continue;
+            if (polled < 0) throw runtime_error(string("poll: ") + strerror(errno));
+            if (polled == 0) throw runtime_error("нет ответа дольше срока");
+        }
+        ssize_t n = read(fd, p + done, bytes - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 && done == 0) return false;
+        if (n <= 0) throw runtime_error("соединение закрыто посреди сообщения");
+        done += n;
+    }
+    return true;
+}
+
+vector<ShardInfo> writeShards(const CarDataset& data, size_t numShards, const string& pathPrefix, ThreadPool& pool) {
+    numShards = max<size_t>(numShards, 1);
+    const size_t blockRows = CarDataset::kBlockRows;
+    size_t shardRows = max((data.size() / numShards + blockRows - 1) / blockRows * blockRows, blockRows);
+    
+    vector<ShardInfo> shards;
+    for (size_t s = 0; s < numShards; ++s) {
+        size_t start = min(s * shardRows, data.size());
+        size_t end = (s == numShards - 1) ? data.size() : min(start + shardRows, data.size());
+        
+        CarColumns columns;
+        columns.prices.assign(data.getPrices() + start, data.getPrices() + end);
+        columns.mileages.assign(data.getMileages() + start, data.getMileages() + end);
+        columns.years.assign(data.getYears() + start, data.getYears() + end);
+        columns.brands.assign(data.getBrands() + start, data.getBrands() + end);
+        columns.bodyTypes.assign(data.getBodyTypes() + start, data.getBodyTypes() + end);
+        
+        ShardInfo shard{pathPrefix + "." + to_string(s) + ".bin", start, end - start};
+        try {
+            CarDataset::create(move(columns), false, pool)->writeFile(shard.path);
+        } catch (...) {
+            // Недописанный и уже записанные шарды без координатора не нужны
+            error_code ignored;
+            filesystem::remove(shard.path, ignored);
+            for (const ShardInfo& written : shards) {
+                filesystem::remove(written.path, ignored);
+            }
+            throw;
+        }
+        shards.push_back(move(shard));
+    }
+    return shards;
+}
+
+// Цикл обслуживания в дочернем процессе; возвращается, когда координатор закрыл сокет
+static void serveShard(const ShardInfo& shard, int fd, int numThreads) {
+    ThreadPool pool(numThreads);
+    shared_ptr<const CarDataset> data;
+    string loadError;
+    try {
+        data = CarDataset::mapFile(shard.path, false, pool);
+    } catch (const exception& e) {
+        loadError = e.what();
+    }
+    
+    ShardRequest request;
+    while (readAll(fd, &request, sizeof(request))) {
+        vector<char> payload;
+        ShardResponseHeader header{0, 0};
+        try {
+            if (!data) throw runtime_error(loadError);
+            CarProcessor processor(data, pool);
+            processor.setScanMode(ScanMode::Columnar);
+            
+            if (request.kind == ShardRequestKind::Count) {
+                uint64_t count = processor.aggregate(request.criteria, numThreads).count;
+                payload.resize(sizeof(count));
+                memcpy(payload.data(), &count, sizeof(count));
+            } else if (request.kind == ShardRequestKind::Rows) {
+                vector<RowId> rows = processor.selectMultiThread(request.criteria, numThreads).getRows();
+                for (RowId& row : rows) row += static_cast<RowId>(shard.firstRow);
+                payload.resize(rows.size() * sizeof(RowId));
+                memcpy(payload.data(), rows.data(), payload.size());
+            } else {
+                CarSelection top = processor.selectTopK(request.criteria, request.order, request.limit, numThreads);
+                const int* values = request.order.field == SortField::Mileage ? data->getMileages()
+                                  : request.order.field == SortField::Year ? data->getYears() : data->getPrices();
+                vector<ShardTopEntry> entries(top.size());
+                for (size_t i = 0; i < top.size(); ++i) {
+                    long long value = values[top.rowAt(i)];
+                    entries[i] = {request.order.descending ? -value : value,
+                                  static_cast<RowId>(top.rowAt(i) + shard.firstRow)};
+                }
+                payload.resize(entries.size() * sizeof(ShardTopEntry));
+                memcpy(payload.data(), entries.data(), payload.size());
+            }
+        } catch (const exception& e) {
+            header.status = -1;
+            string message = e.what();
+            payload.assign(message.begin(), message.end());
+        }
+        
+        header.bytes = payload.size();
+        writeAll(fd, &header, sizeof(header));
+        writeAll(fd, payload.data(), payload.size());
+    }
+}
+
+ShardCoordinator::ShardCoordinator(const vector<ShardInfo>& shards, int threadsPerShard) {
+    if (threadsPerShard <= 0) {
+        int cores = static_cast<int>(thread::hardware_concurrency());
+        threadsPerShard = max(1, (cores > 0 ? cores : 4) / max<int>(static_cast<int>(shards.size()), 1));
+    }
+    
+    for (const ShardInfo& shard : shards) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            stopWorkers();
+            throw runtime_error(string("socketpair: ") + strerror(errno));
+        }
+        
+        pid_t pid = fork();
+        if (pid < 0) {
+            int err = errno;
+            close(fds[0]);
+            close(fds[1]);
+            stopWorkers();
+            throw runtime_error(string("fork: ") + strerror(err));
+        }
+        
+        if (pid == 0) {
+            // Дочерний процесс: сокеты остальных шардов ему не нужны
+            close(fds[0]);
+            for (const Worker& other : workers) close(other.socket);
+            int code = 0;
+            try {
+                serveShard(shard, fds[1], threadsPerShard);
+            } catch (...) {
+                code = 1;
+            }
+            // _exit: деструкторы статических объектов родителя (общий пул) в копии процесса не вызываются
+            _exit(code);
+        }
+        
+        close(fds[1]);
+        workers.push_back({shard, pid, fds[0]});
+    }
+}
+
+ShardCoordinator::~ShardCoordinator() {
+    stopWorkers();
+}
+
+void ShardCoordinator::stopWorkers() {
+    // Закрытие сокета завершает цикл обслуживания шарда
+    for (Worker& worker : workers) {
+        close(worker.socket);
+    }
+    for (Worker& worker : workers) {
+        int status;
+        while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+    }
+    workers.clear();
+}
+
+vector<vector<char>> ShardCoordinator::scatterGather(const vector<char>& request) {
+    if (!brokenReason.empty()) {
+        throw runtime_error("Координатор шардов неработоспособен: " + brokenReason);
+    }
+    
+    // Шард, которому не удалось передать запрос, ответа не пришлет
+    vector<bool> sent(workers.size(), false);
+    string error;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        try {
+            writeAll(workers[i].socket, request.data(), request.size());
+            sent[i] = true;
+        } catch (const exception& e) {
+            if (brokenReason.empty()) brokenReason = workers[i].shard.path + ": " + e.what();
+        }
+    }
+    
+    // Ответы читаются все, даже после ошибки одного шарда, чтобы протокол не рассинхронизировался.
+    // Ошибка запроса в шарде (status != 0) оставляет протокол целым; обрыв соединения - нет,
+    // и после него координатор больше не принимает запросов.
+    // Шарды работают одновременно, поэтому срок общий на весь запрос. Шард, не уложившийся в срок,
+    // считается потерянным и завершается, чтобы деструктор не ждал его вечно.
+    auto deadline = chrono::steady_clock::now() + replyTimeout;
+    vector<vector<char>> responses(workers.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (!sent[i]) continue;
+        try {
+            ShardResponseHeader header;
+            if (!readAll(workers[i].socket, &header, sizeof(header), deadline)) {
+                throw runtime_error("шард завершился");
+            }
+            responses[i].resize(header.bytes);
+            if (!readAll(workers[i].socket, responses[i].data(), header.bytes, deadline)) {
+                throw runtime_error("шард закрыл соединение до данных ответа");
+            }
+            if (header.status != 0 && error.empty()) {
+                error = workers[i].shard.path + ": " + string(responses[i].begin(), responses[i].end());
+            }
+        } catch (const exception& e) {
+            if (brokenReason.empty()) brokenReason = workers[i].shard.path + ": " + e.what();
+            kill(workers[i].pid, SIGKILL);
+        }
+    }
+    if (!brokenReason.empty()) throw runtime_error("Шард " + brokenReason);
+    if (!error.empty()) throw runtime_error(error);
+    return responses;
+}
+
+static vector<char> encodeRequest(ShardRequestKind kind, const CarCriteria& criteria, SortOrder order = {}, size_t limit = 0) {
+    ShardRequest request{kind, criteria, order, limit};
+    vector<char> bytes(sizeof(request));
+    memcpy(bytes.data(), &request, sizeof(request));
+    return bytes;
+}
+
+size_t ShardCoordinator::count(const CarCriteria& criteria) {
+    size_t total = 0;
+    for (const auto& response : scatterGather(encodeRequest(ShardRequestKind::Count, criteria))) {
+        uint64_t count;
+        memcpy(&count, response.data(), sizeof(count));
+        total += count;
+    }
+    return total;
+}
+
+vector<RowId> ShardCoordinator::selectRows(const CarCriteria& criteria) {
+    vector<vector<char>> responses = scatterGather(encodeRequest(ShardRequestKind::Rows, criteria));
+    
+    // Шарды - последовательные диапазоны, поэтому склейка в порядке шардов сохраняет порядок строк
+    size_t total = 0;
+    for (const auto& response : responses) total += response.size() / sizeof(RowId);
+    vector<RowId> rows(total);
+    size_t pos = 0;
+    for (const auto& response : responses) {
+        memcpy(rows.data() + pos, response.data(), response.size());
+        pos += response.size() / sizeof(RowId);
+    }
+    return rows;
+}
+
+vector<RowId> ShardCoordinator::selectTopK(const CarCriteria& criteria, SortOrder order, size_t limit) {
+    vector<ShardTopEntry> candidates;
+    for (const auto& response : scatterGather(encodeRequest(ShardRequestKind::TopK, criteria, order, limit))) {
+        size_t n = response.size() / sizeof(ShardTopEntry);
+        size_t pos = candidates.size();
+        candidates.resize(pos + n);
+        memcpy(candidates.data() + pos, response.data(), response.size());
+    }
+    
+    // Каждый шард прислал свои limit лучших; общий топ - первые limit из объединения
+    size_t count = min(limit, candidates.size());
+    auto before = [](const ShardTopEntry& a, const ShardTopEntry& b) {
+        return a.key != b.key ? a.key < b.key : a.row < b.row;
+    };
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), before);
+    
+    vector<RowId> rows(count);
+    for (size_t i = 0; i < count; ++i) {
+        rows[i] = candidates[i].row;
+    }
+    return rows;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <vector>
+#include <sys/types.h>
+#include "car.h"
+#include "car_dataset.h"
+#include "car_processor.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Шард - непрерывный диапазон строк набора, сохраненный в отдельный двоичный файл
+struct ShardInfo {
+    string path;
+    size_t firstRow = 0;     // Номер первой строки шарда в исходном наборе
+    size_t rowCount = 0;
+};
+
+// Делит снимок на numShards диапазонов, выровненных по блокам зонных карт (как чанки
+// многопоточного просмотра), и сохраняет каждый в pathPrefix.<номер>.bin.
+// Если запись прервалась (например, кончилось место), уже созданные файлы удаляются, а исключение пробрасывается
+vector<ShardInfo> writeShards(const CarDataset& data, size_t numShards, const string& pathPrefix,
+                              ThreadPool& pool = ThreadPool::shared());
+
+// Координатор рассылки запросов по процессам-шардам на одной машине.
+// Для каждого шарда порождается процесс (fork), который отображает файл шарда и обслуживает
+// запросы через свою пару Unix-сокетов. Запрос сначала отправляется всем шардам, затем собираются
+// ответы, так что шарды работают одновременно. Номера строк в ответах - номера исходного набора.
+//
+// Процессы порождаются в конструкторе. В этот момент другие потоки не должны менять словари
+// (дочерний процесс наследует их копию), а пул ThreadPool::shared() в дочернем процессе
+// не используется: у каждого шарда свой пул.
+class ShardCoordinator {
+private:
+    struct Worker {
+        ShardInfo shard;
+        pid_t pid = -1;
+        int socket = -1;
+    };
+    
+    vector<Worker> workers;
+    string brokenReason;     // Непусто после обрыва связи с шардом: ответы уже не сопоставить запросам
+    chrono::milliseconds replyTimeout = kDefaultReplyTimeout;
+    
+    // Рассылает запрос всем шардам и читает ответы в порядке шардов.
+    // После обрыва связи с любым шардом или ответа позже replyTimeout этот и все следующие вызовы
+    // бросают runtime_error.
+    vector<vector<char>> scatterGather(const vector<char>& request);
+    
+    void stopWorkers();
+    
+public:
+    static constexpr chrono::milliseconds kDefaultReplyTimeout{60000};
+    
+    // threadsPerShard == 0 - логические ядра поровну между шардами
+    explicit ShardCoordinator(const vector<ShardInfo>& shards, int threadsPerShard = 0);
+    ~ShardCoordinator();
+    
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+    
+    size_t getShardCount() const { return workers.size(); }
+    
+    // false - связь с одним из шардов оборвалась, и запросы больше не выполняются
+    bool isUsable() const { return brokenReason.empty(); }
+    
+    // Сколько запрос ждет ответов всех шардов; зависший шард считается потерянным
+    void setReplyTimeout(chrono::milliseconds timeout) { replyTimeout = timeout; }
+    chrono::milliseconds getReplyTimeout() const { return replyTimeout; }
+    
+    // Сумма количеств по шардам
+    size_t count(const CarCriteria& criteria);
+    
+    // Номера подходящих строк исходного набора по возрастанию
+    vector<RowId> selectRows(const CarCriteria& criteria);
+    
+    // Первые limit строк в порядке order, как CarProcessor::selectTopK по всему набору
+    vector<RowId> selectTopK(const CarCriteria& criteria, SortOrder order, size_t limit);
+};
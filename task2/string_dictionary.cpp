@@ -0,0 +1,54 @@
+#include "string_dictionary.h"
+#include <mutex>
+#include <stdexcept>
+#include <limits>
+
+using namespace std;
+
+StringCode StringDictionary::intern(string_view value) {
+    {
+        shared_lock<shared_mutex> lock(mtx);
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+    }
+    
+    unique_lock<shared_mutex> lock(mtx);
+    // Строку мог добавить другой поток, пока блокировка была снята
+    auto it = codes.find(value);
+    if (it != codes.end()) return it->second;
+    
+    if (values.size() > numeric_limits<StringCode>::max()) {
+        throw length_error("Словарь строк переполнен");
+    }
+    StringCode code = static_cast<StringCode>(values.size());
+    values.emplace_back(value);
+    codes.emplace(values.back(), code);
+    return code;
+}
+
+int StringDictionary::find(string_view value) const {
+    shared_lock<shared_mutex> lock(mtx);
+    auto it = codes.find(value);
+    return it == codes.end() ? -1 : it->second;
+}
+
+const string& StringDictionary::name(StringCode code) const {
+    // Элементы deque не перемещаются при добавлении, ссылка остается действительной
+    shared_lock<shared_mutex> lock(mtx);
+    return values.at(code);
+}
+
+size_t StringDictionary::size() const {
+    shared_lock<shared_mutex> lock(mtx);
+    return values.size();
+}
+
+StringDictionary& brandDictionary() {
+    static StringDictionary dictionary;
+    return dictionary;
+}
+
+StringDictionary& bodyTypeDictionary() {
+    static StringDictionary dictionary;
+    return dictionary;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+
+using namespace std;
+
+// Код строки в словаре
+using StringCode = uint16_t;
+
+// Словарь строк: каждой различной строке соответствует небольшой целый код.
+// Только добавляет значения, поэтому коды и ссылки на строки никогда не меняются.
+// Потокобезопасен: много читателей, добавление под эксклюзивной блокировкой.
+class StringDictionary {
+private:
+    // Хеш с поддержкой поиска по string_view без создания string
+    struct TransparentHash {
+        using is_transparent = void;
+        size_t operator()(string_view s) const { return hash<string_view>()(s); }
+    };
+    
+    mutable shared_mutex mtx;
+    deque<string> values;                                          // Строка по коду
+    unordered_map<string, StringCode, TransparentHash, equal_to<>> codes;   // Код по строке
+    
+public:
+    // Возвращает код строки, добавляя ее при первом появлении
+    StringCode intern(string_view value);
+    
+    // Код существующей строки или -1, если ее нет в словаре
+    int find(string_view value) const;
+    
+    const string& name(StringCode code) const;
+    size_t size() const;
+};
+
+// Общие словари процесса для марок и типов кузова
+StringDictionary& brandDictionary();
+StringDictionary& bodyTypeDictionary();
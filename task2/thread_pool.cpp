@@ -0,0 +1,140 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+// Номер текущего потока в пуле; -1, если поток не является рабочим потоком пула
+static thread_local int t_workerIndex = -1;
+
+ThreadPool::ThreadPool(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(thread::hardware_concurrency());
+        if (numThreads == 0) numThreads = 4; // Запасное значение
+    }
+    
+    workers.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCv.notify_all();
+    
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::currentWorkerIndex() {
+    return t_workerIndex;
+}
+
+bool ThreadPool::pinWorkersToCores() {
+    int cores = static_cast<int>(thread::hardware_concurrency());
+    if (cores <= 0) return false;
+    
+    bool pinned = true;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<int>(i) % cores, &set);
+        pinned = pthread_setaffinity_np(workers[i].native_handle(), sizeof(set), &set) == 0 && pinned;
+    }
+    return pinned;
+}
+
+void ThreadPool::workerLoop(int index) {
+    t_workerIndex = index;
+    
+    while (true) {
+        shared_ptr<Job> job;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) return;
+            job = jobs.front();
+        }
+        
+        if (!job->started.exchange(true)) {
+            auto latency = chrono::steady_clock::now() - job->submitted;
+            lastDispatchNs = chrono::duration_cast<chrono::nanoseconds>(latency).count();
+        }
+        
+        runJob(*job);
+        retireJob(job);
+    }
+}
+
+void ThreadPool::runJob(Job& job) {
+    while (true) {
+        size_t i = job.next.fetch_add(1);
+        if (i >= job.count) return;
+        
+        try {
+            job.fn(i);
+        } catch (...) {
+            lock_guard<mutex> lock(job.doneMutex);
+            if (!job.error) job.error = current_exception();
+        }
+        
+        if (job.done.fetch_add(1) + 1 == job.count) {
+            lock_guard<mutex> lock(job.doneMutex);
+            job.doneCv.notify_all();
+        }
+    }
+}
+
+// Убирает задачу из очереди, когда все ее индексы уже розданы
+void ThreadPool::retireJob(const shared_ptr<Job>& job) {
+    lock_guard<mutex> lock(queueMutex);
+    if (!jobs.empty() && jobs.front() == job) {
+        jobs.pop_front();
+    }
+}
+
+void ThreadPool::parallelFor(size_t taskCount, const function<void(size_t)>& fn) {
+    if (taskCount == 0) return;
+    
+    // Вложенный вызов из рабочего потока выполняем на месте, иначе пул может заблокировать сам себя
+    if (t_workerIndex >= 0) {
+        for (size_t i = 0; i < taskCount; ++i) fn(i);
+        return;
+    }
+    
+    auto job = make_shared<Job>();
+    job->fn = fn;
+    job->count = taskCount;
+    job->submitted = chrono::steady_clock::now();
+    
+    {
+        lock_guard<mutex> lock(queueMutex);
+        jobs.push_back(job);
+    }
+    if (taskCount == 1) {
+        queueCv.notify_one();
+    } else {
+        queueCv.notify_all();
+    }
+    
+    {
+        unique_lock<mutex> lock(job->doneMutex);
+        job->doneCv.wait(lock, [&] { return job->done.load() == job->count; });
+    }
+    
+    if (job->error) {
+        rethrow_exception(job->error);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <exception>
+
+using namespace std;
+
+// Пул долгоживущих рабочих потоков.
+// Потоки создаются один раз в конструкторе, запросы передаются им через очередь задач.
+class ThreadPool {
+private:
+    // Одна параллельная задача: fn(i) для i в [0, count)
+    struct Job {
+        function<void(size_t)> fn;
+        size_t count = 0;
+        atomic<size_t> next{0};          // Следующий невыданный индекс
+        atomic<size_t> done{0};          // Количество завершенных индексов
+        atomic<bool> started{false};     // Взят ли уже хотя бы один индекс рабочим потоком
+        chrono::steady_clock::time_point submitted;
+        
+        mutex doneMutex;
+        condition_variable doneCv;
+        exception_ptr error;             // Первое исключение, выброшенное задачей
+    };
+    
+    vector<thread> workers;
+    deque<shared_ptr<Job>> jobs;
+    mutex queueMutex;
+    condition_variable queueCv;
+    bool stopping = false;
+    
+    atomic<long long> lastDispatchNs{0};
+    
+    void workerLoop(int index);
+    void runJob(Job& job);
+    void retireJob(const shared_ptr<Job>& job);
+    
+public:
+    // numThreads == 0 - по числу логических ядер
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Выполняет fn(i) для каждого i в [0, taskCount) и ждет завершения всех задач
+    void parallelFor(size_t taskCount, const function<void(size_t)>& fn);
+    
+    // Общий пул процесса, создается при первом обращении
+    static ThreadPool& shared();
+    
+    int getThreadCount() const { return static_cast<int>(workers.size()); }
+    
+    // Номер рабочего потока пула, на котором выполняется вызов; -1 для остальных потоков
+    static int currentWorkerIndex();
+    
+    // Закрепляет рабочий поток i за логическим ядром i по кругу. Тогда задачи, выбирающие данные
+    // по номеру потока, при каждом запросе читают их на одном и том же ядре.
+    // Возвращает false, если система не позволила закрепить потоки.
+    bool pinWorkersToCores();
+    
+    // Задержка от постановки последнего запроса в очередь до начала его выполнения рабочим потоком
+    double getLastDispatchLatencyUs() const { return lastDispatchNs.load() / 1000.0; }
+};
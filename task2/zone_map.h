@@ -0,0 +1,47 @@
+#pragma once
+#include <climits>
+#include <algorithm>
+#include "car.h"
+
+using namespace std;
+
+// Минимумы и максимумы числовых полей в одном блоке строк
+struct ZoneMap {
+    int minPrice = INT_MAX, maxPrice = INT_MIN;
+    int minMileage = INT_MAX, maxMileage = INT_MIN;
+    int minYear = INT_MAX, maxYear = INT_MIN;
+    
+    void add(int price, int mileage, int year) {
+        minPrice = min(minPrice, price);
+        maxPrice = max(maxPrice, price);
+        minMileage = min(minMileage, mileage);
+        maxMileage = max(maxMileage, mileage);
+        minYear = min(minYear, year);
+        maxYear = max(maxYear, year);
+    }
+    
+    void merge(const ZoneMap& other) {
+        minPrice = min(minPrice, other.minPrice);
+        maxPrice = max(maxPrice, other.maxPrice);
+        minMileage = min(minMileage, other.minMileage);
+        maxMileage = max(maxMileage, other.maxMileage);
+        minYear = min(minYear, other.minYear);
+        maxYear = max(maxYear, other.maxYear);
+    }
+    
+    bool operator==(const ZoneMap&) const = default;
+    
+    // Может ли в блоке найтись хотя бы одна подходящая строка
+    bool mayMatch(const CarCriteria& c) const {
+        return maxPrice >= c.minPrice && minPrice <= c.maxPrice &&
+               minMileage <= c.maxMileage && maxYear >= c.minYear;
+    }
+    
+    // Подходят ли все строки блока (тогда их не нужно проверять по одной)
+    bool allMatch(const CarCriteria& c) const {
+        // Коды марки и кузова в зонной карте не учитываются
+        return !c.hasCodeFilter() &&
+               minPrice >= c.minPrice && maxPrice <= c.maxPrice &&
+               maxMileage <= c.maxMileage && minYear >= c.minYear;
+    }
+};